@@ -0,0 +1,245 @@
+/** rtcheck_stress_benchmark
+
+    Measures how rtcheck scales with the number of real-time threads. Each thread
+    repeatedly enters a realtime_context and does a mix of allocations, locking
+    and nested scope transitions. The throughput and per-iteration latencies are
+    reported for each thread count, both with the work done inside a
+    non_realtime_context (no violations) and directly in the real-time context
+    (every call is a violation, reported with error_mode::cont).
+
+    Shared state in the checker shows up as throughput that doesn't grow with the
+    number of threads and as long tail latencies.
+
+    Usage: rtcheck_stress_benchmark [--max-threads N] [--iterations N] [--no-violations] [--verbose]
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <rtcheck.h>
+
+namespace
+{
+    using clock_type = std::chrono::steady_clock;
+
+    struct options
+    {
+        unsigned max_threads = std::max (std::thread::hardware_concurrency(), 1u);
+        std::size_t iterations = 20000;
+        bool with_violations = true;
+        bool verbose = false;
+    };
+
+    struct alignas (64) worker_state
+    {
+        std::mutex mutex;
+        std::vector<int64_t> latencies_ns;
+        uint64_t checksum = 0;
+    };
+
+    /** Allocates and locks, outside of the real-time context unless violations are wanted. */
+    [[gnu::noinline]] void do_work (worker_state& worker, std::size_t iteration, bool with_violations)
+    {
+        std::optional<rtc::non_realtime_context> nrc;
+
+        if (! with_violations)
+            nrc.emplace();
+
+        const auto size = 16 + (iteration * 37) % 4096;
+
+        if (auto data = static_cast<unsigned char*> (std::malloc (size)))
+        {
+            data[0] = static_cast<unsigned char> (iteration);
+            data[size - 1] = data[0];
+            worker.checksum += data[size - 1];
+            std::free (data);
+        }
+
+        std::scoped_lock lock (worker.mutex);
+        ++worker.checksum;
+    }
+
+    void run_worker (worker_state& worker, const options& opts, bool with_violations,
+                     std::atomic<unsigned>& ready, std::atomic<bool>& start)
+    {
+        worker.latencies_ns.assign (opts.iterations, 0);
+
+        ready.fetch_add (1, std::memory_order_acq_rel);
+
+        while (! start.load (std::memory_order_acquire))
+            std::this_thread::yield();
+
+        for (std::size_t i = 0; i < opts.iterations; ++i)
+        {
+            const auto begin = clock_type::now();
+
+            {
+                rtc::realtime_context rc;
+                do_work (worker, i, with_violations);
+
+                // An extra scope transition, as made around non real-time callbacks
+                {
+                    rtc::non_realtime_context nrc;
+                    worker.checksum += rtc::is_real_time_context() ? 0 : 1;
+                }
+            }
+
+            worker.latencies_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds> (clock_type::now() - begin).count();
+        }
+    }
+
+    struct result
+    {
+        double seconds = 0.0;
+        std::vector<int64_t> latencies_ns;
+    };
+
+    result run (unsigned num_threads, const options& opts, bool with_violations)
+    {
+        std::vector<worker_state> workers (num_threads);
+        std::vector<std::thread> threads;
+        std::atomic<unsigned> ready { 0 };
+        std::atomic<bool> start { false };
+
+        for (auto& worker : workers)
+            threads.emplace_back ([&] { run_worker (worker, opts, with_violations, ready, start); });
+
+        while (ready.load (std::memory_order_acquire) < num_threads)
+            std::this_thread::yield();
+
+        const auto begin = clock_type::now();
+        start.store (true, std::memory_order_release);
+
+        for (auto& t : threads)
+            t.join();
+
+        result r;
+        r.seconds = std::chrono::duration<double> (clock_type::now() - begin).count();
+
+        for (auto& worker : workers)
+            r.latencies_ns.insert (r.latencies_ns.end(), worker.latencies_ns.begin(), worker.latencies_ns.end());
+
+        std::sort (r.latencies_ns.begin(), r.latencies_ns.end());
+
+        return r;
+    }
+
+    double get_percentile_us (const std::vector<int64_t>& sorted, double percentile)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        const auto index = std::min (sorted.size() - 1, static_cast<std::size_t> (percentile / 100.0 * static_cast<double> (sorted.size())));
+        return static_cast<double> (sorted[index]) / 1.0e3;
+    }
+
+    std::vector<unsigned> get_thread_counts (unsigned max_threads)
+    {
+        std::vector<unsigned> counts;
+
+        for (unsigned n = 1; n < max_threads; n *= 2)
+            counts.push_back (n);
+
+        counts.push_back (max_threads);
+
+        return counts;
+    }
+
+    /** Sends stderr to /dev/null whilst in scope so the violation reports don't swamp the results. */
+    struct silence_stderr
+    {
+        explicit silence_stderr (bool should_silence)
+        {
+            if (! should_silence)
+                return;
+
+            std::fflush (stderr);
+            saved_fd = dup (STDERR_FILENO);
+
+            if (const auto null_fd = open ("/dev/null", O_WRONLY); null_fd >= 0)
+            {
+                dup2 (null_fd, STDERR_FILENO);
+                close (null_fd);
+            }
+        }
+
+        ~silence_stderr()
+        {
+            if (saved_fd < 0)
+                return;
+
+            std::fflush (stderr);
+            dup2 (saved_fd, STDERR_FILENO);
+            close (saved_fd);
+        }
+
+        int saved_fd = -1;
+    };
+
+    int print_usage()
+    {
+        std::fprintf (stderr, "Usage: rtcheck_stress_benchmark [--max-threads N] [--iterations N] [--no-violations] [--verbose]\n");
+        return 2;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg (argv[i]);
+
+        if (arg == "--max-threads" && i + 1 < argc)
+            opts.max_threads = std::max (1u, static_cast<unsigned> (std::strtoul (argv[++i], nullptr, 10)));
+        else if (arg == "--iterations" && i + 1 < argc)
+            opts.iterations = std::max (std::size_t (1), static_cast<std::size_t> (std::strtoull (argv[++i], nullptr, 10)));
+        else if (arg == "--no-violations")
+            opts.with_violations = false;
+        else if (arg == "--verbose")
+            opts.verbose = true;
+        else
+            return print_usage();
+    }
+
+    rtc::set_error_mode (rtc::error_mode::cont);
+
+    std::printf ("%8s %12s %14s %10s %10s %10s %10s\n", "threads", "violations", "iterations/s", "p50 us", "p99 us", "p99.9 us", "max us");
+
+    for (const bool with_violations : { false, true })
+    {
+        if (with_violations && ! opts.with_violations)
+            continue;
+
+        for (auto num_threads : get_thread_counts (opts.max_threads))
+        {
+            result r;
+
+            {
+                silence_stderr silence (with_violations && ! opts.verbose);
+                r = run (num_threads, opts, with_violations);
+            }
+
+            const auto total_iterations = static_cast<double> (opts.iterations) * num_threads;
+
+            std::printf ("%8u %12s %14.0f %10.2f %10.2f %10.2f %10.2f\n",
+                         num_threads, with_violations ? "yes" : "no", total_iterations / r.seconds,
+                         get_percentile_us (r.latencies_ns, 50.0), get_percentile_us (r.latencies_ns, 99.0),
+                         get_percentile_us (r.latencies_ns, 99.9), get_percentile_us (r.latencies_ns, 100.0));
+            std::fflush (stdout);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    /** The policy of every check, indexed by check_id. */
+    struct check_policy_table
+    {
+        std::array<check_policy, max_checks> policies {};
+    };
+
+    struct check_policy_state
+    {
+        // nullptr until a policy is set, which leaves every check on check_policy::default_mode
+        std::atomic<const check_policy_table*> table { nullptr };
+
+        // Tables are never freed as other threads may still be reading them
+        std::mutex mutex;
+        std::vector<std::unique_ptr<check_policy_table>> tables;
+    };
+
+    check_policy_state& get_check_policy_state()
+    {
+        static check_policy_state state;
+        return state;
+    }
+
+    //==============================================================================
+    constexpr std::size_t max_sites = 4096;
+
+    /** The call sites that have been reported by check_policy::log_once, as an open addressed set. */
+    std::array<std::atomic<uint64_t>, max_sites>& get_reported_sites()
+    {
+        static std::array<std::atomic<uint64_t>, max_sites> sites {};
+        return sites;
+    }
+
+    //==============================================================================
+    std::string_view trim (std::string_view text)
+    {
+        while (! text.empty() && std::isspace (static_cast<unsigned char> (text.back())))
+            text.remove_suffix (1);
+
+        while (! text.empty() && std::isspace (static_cast<unsigned char> (text.front())))
+            text.remove_prefix (1);
+
+        return text;
+    }
+
+    std::optional<check_policy> find_policy (std::string_view name)
+    {
+        constexpr std::pair<std::string_view, check_policy> names[] =
+        {
+            { "default",    check_policy::default_mode },
+            { "ignore",     check_policy::ignore },
+            { "count",      check_policy::count },
+            { "log_once",   check_policy::log_once },
+            { "log",        check_policy::log },
+            { "exit",       check_policy::exit },
+            { "trap",       check_policy::trap }
+        };
+
+        for (auto& [policy_name, policy] : names)
+            if (name == policy_name)
+                return policy;
+
+        return std::nullopt;
+    }
+
+    /** Parses a rule in the form "checks: policy", returning false if it's invalid. */
+    bool apply_policy_rule (std::string_view rule)
+    {
+        const auto colon = rule.find (':');
+
+        if (colon == std::string_view::npos)
+            return false;
+
+        const auto checks = parse_checks (trim (rule.substr (0, colon)));
+        const auto policy = find_policy (trim (rule.substr (colon + 1)));
+
+        if (checks.none() || ! policy)
+            return false;
+
+        set_check_policy (checks, *policy);
+        return true;
+    }
+}
+
+//==============================================================================
+void set_check_policy (check_flags checks, check_policy policy)
+{
+    auto& state = get_check_policy_state();
+    std::scoped_lock lock (state.mutex);
+
+    auto table = std::make_unique<check_policy_table>();
+
+    if (auto current = state.table.load (std::memory_order_relaxed))
+        *table = *current;
+
+    for (std::size_t i = 0; i < num_checks; ++i)
+        if (checks.test (i))
+            table->policies[i] = policy;
+
+    state.table.store (table.get(), std::memory_order_release);
+    state.tables.push_back (std::move (table));
+}
+
+check_policy get_check_policy (check_id check)
+{
+    if (auto table = get_check_policy_state().table.load (std::memory_order_acquire))
+        return table->policies[static_cast<std::size_t> (check)];
+
+    return check_policy::default_mode;
+}
+
+void reset_check_policies()
+{
+    auto& state = get_check_policy_state();
+
+    {
+        std::scoped_lock lock (state.mutex);
+        state.table.store (nullptr, std::memory_order_release);
+    }
+
+    for (auto& site : get_reported_sites())
+        site.store (0, std::memory_order_relaxed);
+}
+
+bool load_check_policies (const char* path)
+{
+    std::ifstream file (path);
+
+    if (! file)
+        return false;
+
+    int line_number = 0;
+
+    for (std::string line; std::getline (file, line);)
+    {
+        ++line_number;
+        std::string_view text (line);
+
+        if (auto comment = text.find ('#'); comment != std::string_view::npos)
+            text = text.substr (0, comment);
+
+        if (text = trim (text); text.empty())
+            continue;
+
+        if (! apply_policy_rule (text))
+            std::cerr << "rtcheck: ignoring invalid policy at " << path << ':' << line_number << '\n';
+    }
+
+    return true;
+}
+
+void load_check_policies_from_environment()
+{
+    if (const char* rules = std::getenv ("RTCHECK_POLICY"))
+    {
+        for (std::string_view remaining (rules); ! remaining.empty();)
+        {
+            const auto separator = remaining.find (',');
+
+            if (const auto rule = trim (remaining.substr (0, separator)); ! rule.empty() && ! apply_policy_rule (rule))
+                std::cerr << "rtcheck: ignoring invalid policy " << rule << " in RTCHECK_POLICY\n";
+
+            remaining = separator == std::string_view::npos ? std::string_view() : remaining.substr (separator + 1);
+        }
+    }
+
+    if (const char* path = std::getenv ("RTCHECK_POLICY_FILE"); path != nullptr && path[0] != 0)
+        if (! load_check_policies (path))
+            std::cerr << "rtcheck: unable to load policies from " << path << '\n';
+}
+
+error_mode get_error_mode_for_policy (check_policy policy, error_mode mode)
+{
+    switch (policy)
+    {
+        case check_policy::log:
+        case check_policy::log_once:    return mode == error_mode::callback ? error_mode::callback : error_mode::cont;
+        case check_policy::exit:        return error_mode::exit;
+        case check_policy::trap:        return error_mode::trap;
+        case check_policy::default_mode:
+        case check_policy::ignore:
+        case check_policy::count:       break;
+    }
+
+    return mode;
+}
+
+bool is_first_violation_at_site (check_flags check, std::uintptr_t site)
+{
+    // Mixed with the check so different checks at the same site are reported separately
+    auto key = (static_cast<uint64_t> (site) * 0x9e3779b97f4a7c15ull) ^ (get_check_index (check) + 1);
+    key = key == 0 ? 1 : key;
+
+    auto& sites = get_reported_sites();
+
+    for (std::size_t i = 0; i < max_sites; ++i)
+    {
+        auto& slot = sites[(key + i) % max_sites];
+        auto current = slot.load (std::memory_order_relaxed);
+
+        if (current == 0 && slot.compare_exchange_strong (current, key, std::memory_order_relaxed))
+            return true;
+
+        if (current == key)
+            return false;
+    }
+
+    // Once the set is full every violation is reported rather than risk hiding new ones
+    return true;
+}
+}
@@ -0,0 +1,177 @@
+#include <bit>
+#include <chrono>
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    /** Incremented by reset_cycle_stats, each slot clears itself when it sees a new value. */
+    std::atomic<uint64_t>& get_cycle_reset_generation()
+    {
+        static std::atomic<uint64_t> generation { 0 };
+        return generation;
+    }
+
+    // Only the owning thread writes to the slot so these don't need read-modify-writes
+    template<typename T>
+    void increment (std::atomic<T>& value)
+    {
+        value.store (value.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::size_t get_jitter_bucket (int64_t jitter_ns)
+    {
+        const auto jitter_us = static_cast<uint64_t> (jitter_ns < 0 ? -jitter_ns : jitter_ns) / 1000;
+        return std::min (static_cast<std::size_t> (std::bit_width (jitter_us)), cycle_stats::num_jitter_buckets - 1);
+    }
+
+    std::size_t get_load_bucket (int64_t elapsed_ns, int64_t period_ns)
+    {
+        const auto percent = elapsed_ns * 100 / period_ns;
+        return std::min (static_cast<std::size_t> (percent / 5), cycle_stats::num_load_buckets - 1);
+    }
+
+    void record_overrun_streak (thread_slot& slot, uint32_t length)
+    {
+        const auto bucket = std::min (static_cast<std::size_t> (length - 1), cycle_stats::num_overrun_streak_buckets - 1);
+        increment (slot.overrun_streak_histogram[bucket]);
+    }
+
+    void record_cycle_start (thread_slot& slot, int64_t start_ns, int64_t period_ns)
+    {
+        if (const auto generation = get_cycle_reset_generation().load (std::memory_order_relaxed);
+            slot.cycle_reset_generation.load (std::memory_order_relaxed) != generation)
+            clear_cycle_stats (slot);
+
+        // The first cycle, or the first after the period changes, has nothing to be late against
+        if (slot.expected_cycle_start_ns != 0 && slot.cycle_period_ns.load (std::memory_order_relaxed) == period_ns)
+        {
+            const auto jitter_ns = start_ns - slot.expected_cycle_start_ns;
+            increment (slot.jitter_histogram[get_jitter_bucket (jitter_ns)]);
+
+            if (jitter_ns > slot.max_jitter_ns.load (std::memory_order_relaxed))
+                slot.max_jitter_ns.store (jitter_ns, std::memory_order_relaxed);
+        }
+
+        slot.cycle_period_ns.store (period_ns, std::memory_order_relaxed);
+        slot.expected_cycle_start_ns = start_ns + period_ns;
+    }
+
+    void record_cycle_end (thread_slot& slot, int64_t elapsed_ns, int64_t period_ns)
+    {
+        increment (slot.num_cycles);
+        increment (slot.load_histogram[get_load_bucket (elapsed_ns, period_ns)]);
+
+        const auto streak = slot.current_overrun_streak.load (std::memory_order_relaxed);
+
+        if (elapsed_ns > period_ns)
+        {
+            increment (slot.num_overruns);
+            slot.current_overrun_streak.store (streak + 1, std::memory_order_relaxed);
+
+            if (streak + 1 > slot.longest_overrun_streak.load (std::memory_order_relaxed))
+                slot.longest_overrun_streak.store (streak + 1, std::memory_order_relaxed);
+        }
+        else if (streak > 0)
+        {
+            record_overrun_streak (slot, streak);
+            slot.current_overrun_streak.store (0, std::memory_order_relaxed);
+        }
+    }
+
+    cycle_stats get_cycle_stats (const thread_slot& slot)
+    {
+        cycle_stats stats;
+        stats.thread_id = slot.thread_id.load (std::memory_order_relaxed);
+        stats.period = std::chrono::nanoseconds (slot.cycle_period_ns.load (std::memory_order_relaxed));
+        stats.num_cycles = slot.num_cycles.load (std::memory_order_relaxed);
+        stats.num_overruns = slot.num_overruns.load (std::memory_order_relaxed);
+        stats.max_jitter = std::chrono::nanoseconds (slot.max_jitter_ns.load (std::memory_order_relaxed));
+        stats.current_overrun_streak = slot.current_overrun_streak.load (std::memory_order_relaxed);
+        stats.longest_overrun_streak = slot.longest_overrun_streak.load (std::memory_order_relaxed);
+
+        for (std::size_t i = 0; i < stats.jitter.size(); ++i)
+            stats.jitter[i] = slot.jitter_histogram[i].load (std::memory_order_relaxed);
+
+        for (std::size_t i = 0; i < stats.load.size(); ++i)
+            stats.load[i] = slot.load_histogram[i].load (std::memory_order_relaxed);
+
+        for (std::size_t i = 0; i < stats.overrun_streaks.size(); ++i)
+            stats.overrun_streaks[i] = slot.overrun_streak_histogram[i].load (std::memory_order_relaxed);
+
+        return stats;
+    }
+
+    bool has_current_cycle_stats (const thread_slot& slot)
+    {
+        return slot.cycle_reset_generation.load (std::memory_order_relaxed) == get_cycle_reset_generation().load (std::memory_order_relaxed)
+                && slot.num_cycles.load (std::memory_order_relaxed) > 0;
+    }
+}
+
+//==============================================================================
+void clear_cycle_stats (thread_slot& slot)
+{
+    slot.cycle_reset_generation.store (get_cycle_reset_generation().load (std::memory_order_relaxed), std::memory_order_relaxed);
+    slot.cycle_period_ns.store (0, std::memory_order_relaxed);
+    slot.num_cycles.store (0, std::memory_order_relaxed);
+    slot.num_overruns.store (0, std::memory_order_relaxed);
+    slot.max_jitter_ns.store (0, std::memory_order_relaxed);
+    slot.current_overrun_streak.store (0, std::memory_order_relaxed);
+    slot.longest_overrun_streak.store (0, std::memory_order_relaxed);
+
+    for (auto& count : slot.jitter_histogram)
+        count.store (0, std::memory_order_relaxed);
+
+    for (auto& count : slot.load_histogram)
+        count.store (0, std::memory_order_relaxed);
+
+    for (auto& count : slot.overrun_streak_histogram)
+        count.store (0, std::memory_order_relaxed);
+
+    slot.expected_cycle_start_ns = 0;
+}
+
+//==============================================================================
+cycle_scope::cycle_scope (std::chrono::nanoseconds period)
+    : slot (get_thread_slot()),
+      start_ns (get_time_ns()),
+      period_ns (std::max (period.count(), int64_t (1)))
+{
+    if (slot != nullptr)
+        record_cycle_start (*slot, start_ns, period_ns);
+}
+
+cycle_scope::~cycle_scope()
+{
+    if (slot != nullptr)
+        record_cycle_end (*slot, get_time_ns() - start_ns, period_ns);
+}
+
+//==============================================================================
+std::vector<cycle_stats> get_cycle_stats()
+{
+    std::vector<cycle_stats> stats;
+
+    for (auto& slot : get_thread_slots())
+        if (slot.in_use.load (std::memory_order_relaxed) && has_current_cycle_stats (slot))
+            stats.push_back (get_cycle_stats (slot));
+
+    return stats;
+}
+
+cycle_stats get_cycle_stats_for_thread()
+{
+    if (auto slot = get_thread_slot_if_claimed(); slot != nullptr && has_current_cycle_stats (*slot))
+        return get_cycle_stats (*slot);
+
+    return {};
+}
+
+void reset_cycle_stats()
+{
+    get_cycle_reset_generation().fetch_add (1, std::memory_order_relaxed);
+}
+}
@@ -23,7 +23,8 @@
     #define INTERCEPTOR(ret_type, func, ...)        \
     extern "C" INTERCEPTOR_ATTRIBUTE ret_type func(__VA_ARGS__)
 
-    #define INTERCEPT_FUNCTION(ret_type, func, ...) static auto real = (ret_type (*)(__VA_ARGS__))dlsym(RTLD_NEXT, #func);
+    // rtc::get_real_function is used rather than dlsym as that is intercepted
+    #define INTERCEPT_FUNCTION(ret_type, func, ...) static auto real = (ret_type (*)(__VA_ARGS__))rtc::get_real_function(#func);
 
     #define REAL(func, ...) real __VA_ARGS__
 #elif __APPLE__
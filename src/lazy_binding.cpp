@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include <dlfcn.h>
+
+#if __linux__
+ #include <elf.h>
+ #include <link.h>
+#endif
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+#if __linux__ && (defined (__x86_64__) || defined (__aarch64__) || defined (__i386__) || defined (__arm__))
+namespace
+{
+   #if defined (__x86_64__)
+    constexpr auto jump_slot_type = R_X86_64_JUMP_SLOT;
+   #elif defined (__aarch64__)
+    constexpr auto jump_slot_type = R_AARCH64_JUMP_SLOT;
+   #elif defined (__i386__)
+    constexpr auto jump_slot_type = R_386_JMP_SLOT;
+   #elif defined (__arm__)
+    constexpr auto jump_slot_type = R_ARM_JUMP_SLOT;
+   #endif
+
+   #if __LP64__
+    constexpr std::size_t get_relocation_symbol (ElfW(Xword) info)   { return ELF64_R_SYM (info); }
+    constexpr std::size_t get_relocation_type (ElfW(Xword) info)     { return ELF64_R_TYPE (info); }
+   #else
+    constexpr std::size_t get_relocation_symbol (ElfW(Word) info)    { return ELF32_R_SYM (info); }
+    constexpr std::size_t get_relocation_type (ElfW(Word) info)      { return ELF32_R_TYPE (info); }
+   #endif
+
+    /** A GOT entry that still pointed back in to its module's PLT when the check was enabled. */
+    struct lazy_binding_slot
+    {
+        const std::uintptr_t* address = nullptr;
+        std::uintptr_t unresolved_value = 0;
+        const char* symbol_name = nullptr;
+        const char* module_name = nullptr;
+    };
+
+    struct lazy_binding_table
+    {
+        std::unique_ptr<lazy_binding_slot[]> slots;
+
+        // The slots that were still unresolved when last checked, removed as they're
+        // resolved so each check only reads the entries that can still change
+        std::unique_ptr<uint32_t[]> pending;
+        std::atomic<std::size_t> num_pending { 0 };
+
+        // Held whilst checking so pending is only compacted by one thread at a time
+        std::atomic_flag is_checking;
+    };
+
+    struct lazy_binding_state
+    {
+        std::atomic<lazy_binding_table*> table { nullptr };
+
+        // Tables are never freed as real-time threads may still be reading them and
+        // the modules they refer to are kept loaded
+        std::mutex mutex;
+        std::vector<std::unique_ptr<lazy_binding_table>> tables;
+    };
+
+    lazy_binding_state& get_lazy_binding_state()
+    {
+        static lazy_binding_state state;
+        return state;
+    }
+
+    //==============================================================================
+    struct unresolved_slot
+    {
+        const std::uintptr_t* address;
+        std::uintptr_t value;
+        const char* symbol_name;
+        const char* module_name;
+    };
+
+    bool is_rtcheck_module (const dl_phdr_info& info)
+    {
+        Dl_info rtcheck_info {};
+        link_map* rtcheck_map = nullptr;
+
+        return dladdr1 (reinterpret_cast<const void*> (&lazy_binding_check), &rtcheck_info,
+                        reinterpret_cast<void**> (&rtcheck_map), RTLD_DL_LINKMAP) != 0
+                && rtcheck_map != nullptr && rtcheck_map->l_addr == info.dlpi_addr;
+    }
+
+    bool is_rtcheck_symbol (std::string_view name)
+    {
+        return name.starts_with ("_ZN3rtc") || name.starts_with ("_ZNK3rtc");
+    }
+
+    /** Some loaders relocate the dynamic section in place and some don't. */
+    std::uintptr_t get_dynamic_address (const dl_phdr_info& info, ElfW(Addr) address)
+    {
+        return address < info.dlpi_addr ? info.dlpi_addr + address : address;
+    }
+
+    template<typename Relocation>
+    void find_unresolved_slots (const dl_phdr_info& info, const char* module_name,
+                                std::uintptr_t jump_relocations, std::size_t jump_relocations_size,
+                                const ElfW(Sym)* symbols, const char* strings,
+                                std::uintptr_t module_begin, std::uintptr_t module_end,
+                                std::vector<unresolved_slot>& unresolved)
+    {
+        auto relocations = reinterpret_cast<const Relocation*> (jump_relocations);
+
+        for (std::size_t i = 0; i < jump_relocations_size / sizeof (Relocation); ++i)
+        {
+            const auto& relocation = relocations[i];
+
+            if (get_relocation_type (relocation.r_info) != jump_slot_type)
+                continue;
+
+            auto address = reinterpret_cast<const std::uintptr_t*> (info.dlpi_addr + relocation.r_offset);
+            const auto value = __atomic_load_n (address, __ATOMIC_RELAXED);
+
+            // Unresolved slots point back in to the module's own PLT
+            if (value < module_begin || value >= module_end)
+                continue;
+
+            const auto& symbol = symbols[get_relocation_symbol (relocation.r_info)];
+            const char* symbol_name = strings + symbol.st_name;
+
+            // Calls in to rtcheck, e.g. the first ~realtime_context, are resolved inside the scope
+            if (is_rtcheck_symbol (symbol_name))
+                continue;
+
+            unresolved.push_back ({ address, value, symbol_name, module_name });
+        }
+    }
+
+    int add_module_slots (dl_phdr_info* info, size_t, void* data)
+    {
+        auto& unresolved = *static_cast<std::vector<unresolved_slot>*> (data);
+        const ElfW(Dyn)* dynamic = nullptr;
+        std::uintptr_t module_begin = UINTPTR_MAX, module_end = 0;
+
+        for (int i = 0; i < info->dlpi_phnum; ++i)
+        {
+            const auto& header = info->dlpi_phdr[i];
+
+            if (header.p_type == PT_DYNAMIC)
+            {
+                dynamic = reinterpret_cast<const ElfW(Dyn)*> (info->dlpi_addr + header.p_vaddr);
+            }
+            else if (header.p_type == PT_LOAD)
+            {
+                module_begin = std::min (module_begin, static_cast<std::uintptr_t> (info->dlpi_addr + header.p_vaddr));
+                module_end = std::max (module_end, static_cast<std::uintptr_t> (info->dlpi_addr + header.p_vaddr + header.p_memsz));
+            }
+        }
+
+        // rtcheck's own lazy bindings can happen inside the interceptors and can't
+        // be avoided by the user so aren't reported
+        if (dynamic == nullptr || is_rtcheck_module (*info))
+            return 0;
+
+        std::uintptr_t jump_relocations = 0, symbols = 0, strings = 0;
+        std::size_t jump_relocations_size = 0;
+        ElfW(Sxword) relocation_type = DT_RELA;
+
+        for (auto entry = dynamic; entry->d_tag != DT_NULL; ++entry)
+        {
+            switch (entry->d_tag)
+            {
+                case DT_JMPREL:     jump_relocations = get_dynamic_address (*info, entry->d_un.d_ptr); break;
+                case DT_PLTRELSZ:   jump_relocations_size = entry->d_un.d_val; break;
+                case DT_PLTREL:     relocation_type = static_cast<ElfW(Sxword)> (entry->d_un.d_val); break;
+                case DT_SYMTAB:     symbols = get_dynamic_address (*info, entry->d_un.d_ptr); break;
+                case DT_STRTAB:     strings = get_dynamic_address (*info, entry->d_un.d_ptr); break;
+                case DT_BIND_NOW:   return 0;
+                case DT_FLAGS:      if (entry->d_un.d_val & DF_BIND_NOW) return 0; break;
+                case DT_FLAGS_1:    if (entry->d_un.d_val & DF_1_NOW) return 0; break;
+                default:            break;
+            }
+        }
+
+        if (jump_relocations == 0 || symbols == 0 || strings == 0)
+            return 0;
+
+        // Take a reference so the module can't be unloaded whilst its GOT is being read
+        const char* module_name = info->dlpi_name;
+
+        if (module_name != nullptr && module_name[0] != 0)
+        {
+            static auto real_dlopen = reinterpret_cast<void* (*) (const char*, int)> (get_real_function ("dlopen"));
+
+            if (real_dlopen (module_name, RTLD_LAZY | RTLD_NOLOAD) == nullptr)
+                return 0;
+        }
+        else
+        {
+            module_name = program_invocation_name;
+        }
+
+        if (relocation_type == DT_RELA)
+            find_unresolved_slots<ElfW(Rela)> (*info, module_name, jump_relocations, jump_relocations_size,
+                                               reinterpret_cast<const ElfW(Sym)*> (symbols), reinterpret_cast<const char*> (strings),
+                                               module_begin, module_end, unresolved);
+        else
+            find_unresolved_slots<ElfW(Rel)> (*info, module_name, jump_relocations, jump_relocations_size,
+                                              reinterpret_cast<const ElfW(Sym)*> (symbols), reinterpret_cast<const char*> (strings),
+                                              module_begin, module_end, unresolved);
+
+        return 0;
+    }
+
+    void log_lazy_binding (const lazy_binding_slot& slot)
+    {
+        std::string_view module (slot.module_name);
+
+        if (auto last_slash = module.rfind ('/'); last_slash != std::string_view::npos)
+            module = module.substr (last_slash + 1);
+
+        char message[256];
+        std::snprintf (message, sizeof (message),
+                       "Real-time violation: lazily bound symbol %s in %.*s was resolved in real-time context! Link with -z now or call it before entering the real-time context.",
+                       slot.symbol_name, static_cast<int> (module.size()), module.data());
+
+        log_violation (check_flags::lazy_binding, slot.symbol_name, {}, message);
+    }
+}
+
+//==============================================================================
+void lazy_binding_check()
+{
+    auto table = get_lazy_binding_state().table.load (std::memory_order_acquire);
+
+    if (table == nullptr || table->num_pending.load (std::memory_order_relaxed) == 0)
+        return;
+
+    // As the GOT is shared, a thread that finds another checking leaves any change to the next check
+    if (table->is_checking.test_and_set (std::memory_order_acquire))
+        return;
+
+    const bool is_realtime = is_real_time_context();
+    const auto num_pending = table->num_pending.load (std::memory_order_relaxed);
+    std::size_t num_still_pending = 0;
+
+    for (std::size_t i = 0; i < num_pending; ++i)
+    {
+        const auto index = table->pending[i];
+        const auto& slot = table->slots[index];
+
+        if (__atomic_load_n (slot.address, __ATOMIC_RELAXED) == slot.unresolved_value)
+        {
+            table->pending[num_still_pending++] = index;
+            continue;
+        }
+
+        // Resolutions outside of a real-time context are just removed
+        if (is_realtime)
+            log_lazy_binding (slot);
+    }
+
+    table->num_pending.store (num_still_pending, std::memory_order_relaxed);
+    table->is_checking.clear (std::memory_order_release);
+}
+
+bool enable_lazy_binding_check()
+{
+    auto& state = get_lazy_binding_state();
+    std::scoped_lock lock (state.mutex);
+
+    auto table = std::make_unique<lazy_binding_table>();
+
+    // Everything is resolved at load time so there's nothing to check
+    if (const char* bind_now = std::getenv ("LD_BIND_NOW"); bind_now == nullptr || bind_now[0] == 0)
+    {
+        std::vector<unresolved_slot> unresolved;
+        static auto real_dl_iterate_phdr = reinterpret_cast<int (*) (int (*) (dl_phdr_info*, size_t, void*), void*)> (get_real_function ("dl_iterate_phdr"));
+        real_dl_iterate_phdr (add_module_slots, &unresolved);
+
+        table->slots = std::make_unique<lazy_binding_slot[]> (unresolved.size());
+        table->pending = std::make_unique<uint32_t[]> (unresolved.size());
+
+        for (std::size_t i = 0; i < unresolved.size(); ++i)
+        {
+            auto& slot = table->slots[i];
+            slot.address = unresolved[i].address;
+            slot.unresolved_value = unresolved[i].value;
+            slot.symbol_name = unresolved[i].symbol_name;
+            slot.module_name = unresolved[i].module_name;
+            table->pending[i] = static_cast<uint32_t> (i);
+        }
+
+        table->num_pending.store (unresolved.size(), std::memory_order_relaxed);
+    }
+
+    state.table.store (table.get(), std::memory_order_release);
+    state.tables.push_back (std::move (table));
+
+    return true;
+}
+
+void disable_lazy_binding_check()
+{
+    get_lazy_binding_state().table.store (nullptr, std::memory_order_release);
+}
+#else
+//==============================================================================
+void lazy_binding_check()           {}
+bool enable_lazy_binding_check()    { return false; }
+void disable_lazy_binding_check()   {}
+#endif
+}
@@ -0,0 +1,228 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    struct retired_overhead
+    {
+        std::array<std::atomic<uint64_t>, num_overhead_categories> overhead_ticks {};
+        std::atomic<uint64_t> num_hook_calls { 0 }, max_hook_ticks { 0 };
+    };
+
+    /** Overhead from threads that have exited. */
+    retired_overhead& get_retired_overhead()
+    {
+        static retired_overhead retired;
+        return retired;
+    }
+
+    /** A pair of readings used to convert cycle counter ticks to time. */
+    struct tick_reference
+    {
+        uint64_t ticks = read_cycle_counter();
+        int64_t ns = get_time_ns();
+    };
+
+    tick_reference& get_tick_reference()
+    {
+        static tick_reference reference;
+        return reference;
+    }
+
+    double get_ns_per_tick()
+    {
+        const auto& reference = get_tick_reference();
+        constexpr int64_t min_calibration_ns = 10'000'000;
+
+        if (const auto elapsed = get_time_ns() - reference.ns; elapsed < min_calibration_ns)
+            std::this_thread::sleep_for (std::chrono::nanoseconds (min_calibration_ns - elapsed));
+
+        const auto now_ticks = read_cycle_counter();
+        const auto now_ns = get_time_ns();
+
+        if (now_ticks <= reference.ticks)
+            return 1.0;
+
+        return static_cast<double> (now_ns - reference.ns) / static_cast<double> (now_ticks - reference.ticks);
+    }
+
+    void store_max (std::atomic<uint64_t>& max, uint64_t value)
+    {
+        for (auto current = max.load (std::memory_order_relaxed);
+             value > current && ! max.compare_exchange_weak (current, value, std::memory_order_relaxed);)
+        {}
+    }
+
+    //==============================================================================
+    struct overhead_ticks
+    {
+        std::array<uint64_t, num_overhead_categories> ticks {};
+        uint64_t num_hook_calls = 0, max_hook_ticks = 0;
+    };
+
+    /** Reads the totals of either a thread slot or the retired overhead. */
+    template<typename Source>
+    overhead_ticks read_overhead_ticks (const Source& source)
+    {
+        overhead_ticks result;
+
+        for (std::size_t i = 0; i < num_overhead_categories; ++i)
+            result.ticks[i] = source.overhead_ticks[i].load (std::memory_order_relaxed);
+
+        result.num_hook_calls = source.num_hook_calls.load (std::memory_order_relaxed);
+        result.max_hook_ticks = source.max_hook_ticks.load (std::memory_order_relaxed);
+
+        return result;
+    }
+
+    void accumulate (overhead_ticks& total, const overhead_ticks& other)
+    {
+        for (std::size_t i = 0; i < num_overhead_categories; ++i)
+            total.ticks[i] += other.ticks[i];
+
+        total.num_hook_calls += other.num_hook_calls;
+        total.max_hook_ticks = std::max (total.max_hook_ticks, other.max_hook_ticks);
+    }
+
+    overhead_counts to_counts (const overhead_ticks& ticks, double ns_per_tick)
+    {
+        auto to_ns = [ns_per_tick] (uint64_t t) { return std::chrono::nanoseconds (static_cast<int64_t> (static_cast<double> (t) * ns_per_tick)); };
+        auto get = [&] (overhead_category c) { return to_ns (ticks.ticks[static_cast<std::size_t> (c)]); };
+
+        overhead_counts counts;
+        counts.num_hook_calls = ticks.num_hook_calls;
+        counts.hook_time = get (overhead_category::hook);
+        counts.max_hook_time = to_ns (ticks.max_hook_ticks);
+        counts.stack_capture_time = get (overhead_category::stack_capture);
+        counts.reporting_time = get (overhead_category::reporting);
+        counts.realtime_time = get (overhead_category::realtime_scope);
+
+        return counts;
+    }
+
+    //==============================================================================
+    void write_overhead_counts (line_buffer& line, const overhead_counts& counts)
+    {
+        auto to_us = [] (std::chrono::nanoseconds ns) { return static_cast<double> (ns.count()) / 1.0e3; };
+
+        line.append ("%.1fus in hooks of %.1fus in real-time contexts (%.3f%%), %llu hook calls, slowest %.1fus, stack capture %.1fus, reporting %.1fus\n",
+                     to_us (counts.hook_time), to_us (counts.realtime_time), counts.get_realtime_share() * 100.0,
+                     static_cast<unsigned long long> (counts.num_hook_calls), to_us (counts.max_hook_time),
+                     to_us (counts.stack_capture_time), to_us (counts.reporting_time));
+    }
+
+    void print_overhead_summary()
+    {
+        const auto stats = get_overhead_stats();
+
+        line_buffer line;
+        line.append ("rtcheck overhead: ");
+        write_overhead_counts (line, stats.total);
+
+        for (auto& thread : stats.threads)
+        {
+            line.append ("  thread %llu: ", static_cast<unsigned long long> (thread.thread_id));
+            write_overhead_counts (line, thread.counts);
+        }
+
+        write_all (STDERR_FILENO, line.data, line.size);
+    }
+}
+
+//==============================================================================
+void add_overhead (thread_slot& slot, overhead_category category, uint64_t ticks)
+{
+    auto& total = slot.overhead_ticks[static_cast<std::size_t> (category)];
+    total.store (total.load (std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+
+    if (category != overhead_category::hook)
+        return;
+
+    slot.num_hook_calls.store (slot.num_hook_calls.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (ticks > slot.max_hook_ticks.load (std::memory_order_relaxed))
+        slot.max_hook_ticks.store (ticks, std::memory_order_relaxed);
+}
+
+void overhead_release_thread (thread_slot& slot)
+{
+    auto& retired = get_retired_overhead();
+
+    for (std::size_t i = 0; i < num_overhead_categories; ++i)
+        retired.overhead_ticks[i].fetch_add (slot.overhead_ticks[i].exchange (0, std::memory_order_relaxed), std::memory_order_relaxed);
+
+    retired.num_hook_calls.fetch_add (slot.num_hook_calls.exchange (0, std::memory_order_relaxed), std::memory_order_relaxed);
+    store_max (retired.max_hook_ticks, slot.max_hook_ticks.exchange (0, std::memory_order_relaxed));
+}
+
+void load_overhead_options_from_environment()
+{
+    if (const char* value = std::getenv ("RTCHECK_OVERHEAD"); value == nullptr || std::strcmp (value, "1") != 0)
+        return;
+
+    enable_overhead_accounting();
+    std::atexit (print_overhead_summary);
+}
+
+//==============================================================================
+double overhead_counts::get_realtime_share() const
+{
+    if (realtime_time.count() <= 0)
+        return 0.0;
+
+    return static_cast<double> (hook_time.count()) / static_cast<double> (realtime_time.count());
+}
+
+void enable_overhead_accounting()
+{
+    // Take the reference reading used to calibrate the cycle counter
+    get_tick_reference();
+    overhead_accounting_enabled.store (true, std::memory_order_relaxed);
+}
+
+void disable_overhead_accounting()
+{
+    overhead_accounting_enabled.store (false, std::memory_order_relaxed);
+}
+
+overhead_stats get_overhead_stats()
+{
+    const auto ns_per_tick = get_ns_per_tick();
+    auto total = read_overhead_ticks (get_retired_overhead());
+
+    overhead_stats stats;
+
+    for (auto& slot : get_thread_slots())
+    {
+        if (! slot.in_use.load (std::memory_order_relaxed))
+            continue;
+
+        const auto ticks = read_overhead_ticks (slot);
+
+        if (ticks.num_hook_calls == 0 && ticks.ticks[static_cast<std::size_t> (overhead_category::realtime_scope)] == 0)
+            continue;
+
+        accumulate (total, ticks);
+        stats.threads.push_back ({ slot.thread_id.load (std::memory_order_relaxed), to_counts (ticks, ns_per_tick) });
+    }
+
+    stats.total = to_counts (total, ns_per_tick);
+
+    return stats;
+}
+
+overhead_counts get_overhead_stats_for_thread()
+{
+    if (auto slot = get_thread_slot_if_claimed())
+        return to_counts (read_overhead_ticks (*slot), get_ns_per_tick());
+
+    return {};
+}
+}
@@ -0,0 +1,250 @@
+#include <cerrno>
+#include <chrono>
+#include <compare>
+#include <cstdio>
+#include <sched.h>
+#include <sys/resource.h>
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    /** The scheduling of a thread that owns a mutex. */
+    struct mutex_owner
+    {
+        uint64_t thread_id = 0;
+        int policy = SCHED_OTHER;
+        int priority = 0;
+        int nice = 0;                   /// Only read on linux, where it's per thread
+        int priority_inheritance = -1;  /// 1 if enabled, 0 if disabled, -1 if unknown
+    };
+
+   #if __linux__
+    int get_nice (pid_t tid)
+    {
+        // -1 is a valid nice value so errors can only be told apart by errno
+        const auto saved_errno = errno;
+        errno = 0;
+        const auto nice = getpriority (PRIO_PROCESS, static_cast<id_t> (tid));
+        const auto result = errno == 0 ? nice : 0;
+        errno = saved_errno;
+        return result;
+    }
+   #endif
+
+   #if defined (__GLIBC__)
+    // This isn't part of the public headers but has been stable since NPTL was introduced
+    constexpr int glibc_mutex_prio_inherit_flag = 32;
+
+    bool get_mutex_owner (pthread_mutex_t* mutex, mutex_owner& owner)
+    {
+        // The owner is written by glibc whilst holding the lock so may be stale by
+        // the time it's read but the thread id is always valid
+        const auto tid = __atomic_load_n (&mutex->__data.__owner, __ATOMIC_RELAXED);
+        const auto kind = __atomic_load_n (&mutex->__data.__kind, __ATOMIC_RELAXED);
+
+        if (tid <= 0)
+            return false;
+
+        sched_param param {};
+
+        if (const auto policy = sched_getscheduler (tid); policy >= 0 && sched_getparam (tid, &param) == 0)
+        {
+            owner.thread_id = static_cast<uint64_t> (tid);
+            owner.policy = policy & ~SCHED_RESET_ON_FORK;
+            owner.priority = param.sched_priority;
+            owner.nice = get_nice (tid);
+            owner.priority_inheritance = (kind & glibc_mutex_prio_inherit_flag) != 0 ? 1 : 0;
+            return true;
+        }
+
+        return false;
+    }
+   #else
+    /** Owners for platforms where they can't be read from the mutex.
+        This is a direct-mapped table written by the lock and unlock interceptors so
+        colliding mutexes overwrite each other and their owners become unknown.
+        It's constant initialised as it's used before any static constructors run.
+    */
+    struct mutex_owner_entry
+    {
+        std::atomic<pthread_mutex_t*> mutex { nullptr };
+        std::atomic<pthread_t> thread {};
+    };
+
+    std::array<mutex_owner_entry, 1024> mutex_owners;
+
+    mutex_owner_entry& get_mutex_owner_entry (pthread_mutex_t* mutex)
+    {
+        const auto hash = reinterpret_cast<std::uintptr_t> (mutex) / alignof (pthread_mutex_t);
+        return mutex_owners[hash % mutex_owners.size()];
+    }
+
+    bool get_mutex_owner (pthread_mutex_t* mutex, mutex_owner& owner)
+    {
+        auto& entry = get_mutex_owner_entry (mutex);
+        const auto thread = entry.thread.load (std::memory_order_acquire);
+
+        if (entry.mutex.load (std::memory_order_acquire) != mutex
+            || thread == pthread_t {} || pthread_equal (thread, pthread_self()))
+            return false;
+
+        sched_param param {};
+
+        if (pthread_getschedparam (thread, &owner.policy, &param) != 0)
+            return false;
+
+       #if __APPLE__
+        pthread_threadid_np (thread, &owner.thread_id);
+       #endif
+
+        owner.priority = param.sched_priority;
+        return true;
+    }
+   #endif
+
+    //==============================================================================
+    bool is_realtime_policy (int policy)
+    {
+       #ifdef SCHED_DEADLINE
+        if (policy == SCHED_DEADLINE)
+            return true;
+       #endif
+
+        return policy == SCHED_FIFO || policy == SCHED_RR;
+    }
+
+    const char* get_policy_name (int policy)
+    {
+        switch (policy)
+        {
+            case SCHED_OTHER:       return "SCHED_OTHER";
+            case SCHED_FIFO:        return "SCHED_FIFO";
+            case SCHED_RR:          return "SCHED_RR";
+           #ifdef SCHED_BATCH
+            case SCHED_BATCH:       return "SCHED_BATCH";
+           #endif
+           #ifdef SCHED_IDLE
+            case SCHED_IDLE:        return "SCHED_IDLE";
+           #endif
+           #ifdef SCHED_DEADLINE
+            case SCHED_DEADLINE:    return "SCHED_DEADLINE";
+           #endif
+            default:                return "unknown policy";
+        }
+    }
+
+    /** A scheduling priority that can be compared across policies, higher runs first.
+        Real-time policies are ahead of the others and SCHED_IDLE is behind them.
+        Within the normal policies, threads are ordered by their nice value on linux
+        and by their priority on macOS, where it's used for SCHED_OTHER too.
+    */
+    struct effective_priority
+    {
+        int policy_class = 0;
+        int level = 0;
+
+        auto operator<=> (const effective_priority&) const = default;
+    };
+
+    effective_priority get_effective_priority (int policy, int priority, int nice)
+    {
+        if (is_realtime_policy (policy))
+            return { 2, priority };
+
+       #ifdef SCHED_IDLE
+        if (policy == SCHED_IDLE)
+            return { 0, 0 };
+       #endif
+
+        return { 1, priority - nice };
+    }
+
+    /** Returns true if the owner would be scheduled behind the calling thread. */
+    bool is_lower_priority_than_caller (const mutex_owner& owner)
+    {
+        int policy = SCHED_OTHER;
+        sched_param param {};
+
+        if (pthread_getschedparam (pthread_self(), &policy, &param) != 0)
+            return false;
+
+       #if __linux__
+        const auto nice = get_nice (static_cast<pid_t> (get_thread_id()));
+       #else
+        const auto nice = 0;
+       #endif
+
+        return get_effective_priority (owner.policy, owner.priority, owner.nice)
+                < get_effective_priority (policy, param.sched_priority, nice);
+    }
+
+    void log_priority_inversion (const mutex_owner& owner, std::chrono::nanoseconds wait_time)
+    {
+        const char* inheritance = owner.priority_inheritance == 1 ? " with priority inheritance"
+                                : owner.priority_inheritance == 0 ? " without priority inheritance"
+                                : "";
+
+        char message[256];
+        std::snprintf (message, sizeof (message),
+                       "Real-time violation: priority inversion, pthread_mutex_lock waited %.3f ms for a mutex held by thread %llu (%s, priority %d)%s in real-time context!",
+                       static_cast<double> (wait_time.count()) / 1.0e6,
+                       static_cast<unsigned long long> (owner.thread_id),
+                       get_policy_name (owner.policy), owner.priority, inheritance);
+
+        log_violation (check_flags::priority_inversion, "pthread_mutex_lock", {}, message);
+    }
+}
+
+//==============================================================================
+int lock_mutex_checking_priority_inversion (pthread_mutex_t* mutex, mutex_lock_function lock)
+{
+    // The uncontended case doesn't need to look up the owner
+    if (const auto result = pthread_mutex_trylock (mutex); result != EBUSY)
+    {
+        if (result == 0)
+            mutex_locked (mutex);
+
+        return result;
+    }
+
+    // The owner is found before waiting as it may have exited by the time the lock is acquired
+    mutex_owner owner;
+    const bool should_report = get_mutex_owner (mutex, owner)
+                                && owner.thread_id != get_thread_id()
+                                && is_lower_priority_than_caller (owner);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = lock (mutex);
+    const auto wait_time = std::chrono::steady_clock::now() - start;
+
+    if (result == 0)
+        mutex_locked (mutex);
+
+    if (should_report)
+        log_priority_inversion (owner, wait_time);
+
+    return result;
+}
+
+#if defined (__GLIBC__)
+void mutex_locked (pthread_mutex_t*)    {}
+void mutex_unlocked (pthread_mutex_t*)  {}
+#else
+void mutex_locked (pthread_mutex_t* mutex)
+{
+    auto& entry = get_mutex_owner_entry (mutex);
+    entry.thread.store (pthread_t {}, std::memory_order_relaxed);
+    entry.mutex.store (mutex, std::memory_order_release);
+    entry.thread.store (pthread_self(), std::memory_order_release);
+}
+
+void mutex_unlocked (pthread_mutex_t* mutex)
+{
+    if (auto& entry = get_mutex_owner_entry (mutex); entry.mutex.load (std::memory_order_relaxed) == mutex)
+        entry.thread.store (pthread_t {}, std::memory_order_release);
+}
+#endif
+}
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#if __linux__
+ #include <ucontext.h>
+#endif
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+#if __linux__
+namespace
+{
+    constexpr std::size_t max_sample_frames = 64;
+
+    struct sample
+    {
+        std::atomic<uint64_t> sequence { 0 };   /// One more than the write index once published
+        std::size_t num_frames = 0;
+        std::array<void*, max_sample_frames> frames;
+    };
+
+    /** A bounded multi-producer, single-consumer queue written to from the sampling
+        signal handlers. Samples are dropped rather than blocking when it's full.
+    */
+    struct sample_buffer
+    {
+        explicit sample_buffer (std::size_t size)
+            : capacity (size), samples (std::make_unique<sample[]> (size))
+        {}
+
+        const std::size_t capacity;
+        std::unique_ptr<sample[]> samples;
+        std::atomic<uint64_t> write_index { 0 }, read_index { 0 };
+        std::atomic<uint64_t> num_dropped { 0 };
+    };
+
+    struct profiler_state
+    {
+        std::atomic<bool> running { false };
+        profiler_options options;
+        bool handler_installed = false;
+
+        // This is never freed as signal handlers may still be writing to it
+        std::atomic<sample_buffer*> buffer { nullptr };
+
+        // Only accessed by the consumer whilst holding the lock
+        std::mutex stacks_mutex;
+        std::map<std::vector<void*>, uint64_t> stacks;
+    };
+
+    profiler_state& get_profiler_state()
+    {
+        static profiler_state state;
+        return state;
+    }
+
+    //==============================================================================
+    const thread_slot* find_thread_slot (uint64_t tid)
+    {
+        for (auto& slot : get_thread_slots())
+            if (slot.in_use.load (std::memory_order_acquire)
+                && slot.thread_id.load (std::memory_order_relaxed) == tid)
+                return &slot;
+
+        return nullptr;
+    }
+
+    bool get_pc_and_frame_pointer (const void* context, std::uintptr_t& pc, std::uintptr_t& fp)
+    {
+        [[ maybe_unused ]] const auto& mcontext = static_cast<const ucontext_t*> (context)->uc_mcontext;
+
+       #if defined (__x86_64__)
+        pc = static_cast<std::uintptr_t> (mcontext.gregs[REG_RIP]);
+        fp = static_cast<std::uintptr_t> (mcontext.gregs[REG_RBP]);
+        return true;
+       #elif defined (__aarch64__)
+        pc = static_cast<std::uintptr_t> (mcontext.pc);
+        fp = static_cast<std::uintptr_t> (mcontext.regs[29]);
+        return true;
+       #else
+        return false;
+       #endif
+    }
+
+    void take_sample (int, siginfo_t*, void* context)
+    {
+        auto& state = get_profiler_state();
+        auto buffer = state.buffer.load (std::memory_order_acquire);
+
+        if (buffer == nullptr || ! state.running.load (std::memory_order_relaxed))
+            return;
+
+        const auto saved_errno = errno;
+        auto index = buffer->write_index.load (std::memory_order_relaxed);
+
+        do
+        {
+            if (index - buffer->read_index.load (std::memory_order_acquire) >= buffer->capacity)
+            {
+                buffer->num_dropped.fetch_add (1, std::memory_order_relaxed);
+                errno = saved_errno;
+                return;
+            }
+        }
+        while (! buffer->write_index.compare_exchange_weak (index, index + 1, std::memory_order_relaxed));
+
+        auto& s = buffer->samples[index % buffer->capacity];
+        s.num_frames = walk_frame_pointers (context, find_thread_slot (get_thread_id()), s.frames.data(), s.frames.size());
+        s.sequence.store (index + 1, std::memory_order_release);
+
+        errno = saved_errno;
+    }
+
+    /** Moves the published samples from the buffer in to the aggregated stacks. */
+    void collect_samples (profiler_state& state)
+    {
+        auto buffer = state.buffer.load (std::memory_order_acquire);
+
+        if (buffer == nullptr)
+            return;
+
+        for (auto index = buffer->read_index.load (std::memory_order_relaxed);; ++index)
+        {
+            auto& s = buffer->samples[index % buffer->capacity];
+
+            if (s.sequence.load (std::memory_order_acquire) != index + 1)
+                break;
+
+            ++state.stacks[std::vector<void*> (s.frames.begin(), s.frames.begin() + static_cast<std::ptrdiff_t> (s.num_frames))];
+            buffer->read_index.store (index + 1, std::memory_order_release);
+        }
+    }
+
+    void set_timer (timer_t timer, std::chrono::microseconds interval)
+    {
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds> (interval);
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds> (interval - seconds);
+
+        itimerspec spec {};
+        spec.it_value.tv_sec = static_cast<time_t> (seconds.count());
+        spec.it_value.tv_nsec = static_cast<long> (nanoseconds.count());
+        spec.it_interval = spec.it_value;
+
+        timer_settime (timer, 0, &spec, nullptr);
+    }
+}
+
+//==============================================================================
+void cache_stack_bounds (thread_slot& slot)
+{
+    if (slot.stack_end != 0)
+        return;
+
+    if (pthread_attr_t attr; pthread_getattr_np (pthread_self(), &attr) == 0)
+    {
+        void* stack_address = nullptr;
+        std::size_t stack_size = 0;
+
+        if (pthread_attr_getstack (&attr, &stack_address, &stack_size) == 0)
+        {
+            slot.stack_begin = reinterpret_cast<std::uintptr_t> (stack_address);
+            slot.stack_end = slot.stack_begin + stack_size;
+        }
+
+        pthread_attr_destroy (&attr);
+    }
+}
+
+/** Walks the frame pointer chain from the interrupted context.
+    Frame pointers are only followed whilst they're within the thread's stack.
+*/
+std::size_t walk_frame_pointers (const void* context, const thread_slot* slot, void** frames, std::size_t max_frames)
+{
+    std::uintptr_t pc = 0, fp = 0;
+
+    if (max_frames == 0 || ! get_pc_and_frame_pointer (context, pc, fp))
+        return 0;
+
+    std::size_t num_frames = 0;
+    frames[num_frames++] = reinterpret_cast<void*> (pc);
+
+    if (slot == nullptr)
+        return num_frames;
+
+    while (num_frames < max_frames
+           && fp >= slot->stack_begin
+           && fp + 2 * sizeof (std::uintptr_t) <= slot->stack_end
+           && fp % alignof (std::uintptr_t) == 0)
+    {
+        const auto frame = reinterpret_cast<const std::uintptr_t*> (fp);
+        const auto next_fp = frame[0];
+        const auto return_address = frame[1];
+
+        if (return_address == 0)
+            break;
+
+        frames[num_frames++] = reinterpret_cast<void*> (return_address);
+
+        if (next_fp <= fp)
+            break;
+
+        fp = next_fp;
+    }
+
+    return num_frames;
+}
+
+void profiler_scope_enter()
+{
+    auto& state = get_profiler_state();
+
+    if (! state.running.load (std::memory_order_relaxed))
+        return;
+
+    auto slot = get_thread_slot();
+
+    if (slot == nullptr)
+        return;
+
+    if (! slot->has_profiler_timer)
+    {
+        cache_stack_bounds (*slot);
+
+        sigevent event {};
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = state.options.signal;
+        event._sigev_un._tid = static_cast<pid_t> (slot->thread_id.load (std::memory_order_relaxed));
+
+        if (timer_create (CLOCK_THREAD_CPUTIME_ID, &event, &slot->profiler_timer) != 0)
+            return;
+
+        slot->has_profiler_timer = true;
+    }
+
+    set_timer (slot->profiler_timer, state.options.interval);
+    slot->profiler_timer_armed = true;
+}
+
+void profiler_scope_exit()
+{
+    if (auto slot = get_thread_slot_if_claimed(); slot != nullptr && slot->profiler_timer_armed)
+    {
+        set_timer (slot->profiler_timer, {});
+        slot->profiler_timer_armed = false;
+    }
+}
+
+void profiler_release_thread (thread_slot& slot)
+{
+    if (slot.has_profiler_timer)
+        timer_delete (slot.profiler_timer);
+
+    slot.has_profiler_timer = false;
+    slot.profiler_timer_armed = false;
+    slot.stack_begin = 0;
+    slot.stack_end = 0;
+}
+
+//==============================================================================
+bool start_profiler (profiler_options options)
+{
+    auto& state = get_profiler_state();
+
+    if (state.running.load (std::memory_order_relaxed))
+        return false;
+
+    // The handler is left installed after stopping as timers may still fire
+    // until each thread next exits its real-time context
+    if (! state.handler_installed || options.signal != state.options.signal)
+    {
+        struct sigaction action {};
+        action.sa_sigaction = take_sample;
+        action.sa_flags = SA_RESTART | SA_SIGINFO;
+        sigemptyset (&action.sa_mask);
+
+        if (sigaction (options.signal, &action, nullptr) != 0)
+            return false;
+
+        state.handler_installed = true;
+    }
+
+    if (state.buffer.load (std::memory_order_relaxed) == nullptr)
+        state.buffer.store (new sample_buffer (std::max (options.buffer_size, std::size_t (1))), std::memory_order_release);
+
+    state.options = options;
+    state.running.store (true, std::memory_order_relaxed);
+
+    return true;
+}
+
+void stop_profiler()
+{
+    get_profiler_state().running.store (false, std::memory_order_relaxed);
+}
+
+void write_folded_stacks (std::ostream& os)
+{
+    auto& state = get_profiler_state();
+    std::map<std::string, uint64_t> folded_stacks;
+
+    {
+        std::scoped_lock lock (state.stacks_mutex);
+        collect_samples (state);
+
+        for (auto& [frames, count] : state.stacks)
+        {
+            std::string folded;
+
+            // Frames are leaf first and all but the leaf are return addresses
+            for (auto i = frames.size(); i > 0; --i)
+            {
+                const auto address = static_cast<const char*> (frames[i - 1]) - (i > 1 ? 1 : 0);
+                (folded += symbolize (address)) += ';';
+            }
+
+            if (! folded.empty())
+                folded.pop_back();
+
+            folded_stacks[folded] += count;
+        }
+    }
+
+    for (auto& [folded, count] : folded_stacks)
+        os << folded << ' ' << count << '\n';
+}
+#else
+//==============================================================================
+void profiler_scope_enter()                     {}
+void profiler_scope_exit()                      {}
+void profiler_release_thread (thread_slot&)     {}
+
+bool start_profiler (profiler_options)          { return false; }
+void stop_profiler()                            {}
+void write_folded_stacks (std::ostream&)        {}
+#endif
+}
@@ -0,0 +1,218 @@
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    struct rt_log_entry
+    {
+        uint64_t thread_id;
+        int64_t time_ns;
+        char text[240];
+    };
+
+    /** A single producer, single consumer queue for the thread owning a slot.
+        The producer only writes to entries between the read and write indices so
+        messages are formatted straight in to the queue.
+    */
+    struct rt_log_queue
+    {
+        static constexpr uint64_t num_entries = 64;
+
+        alignas (64) std::atomic<uint64_t> write_index { 0 };   /// Only written by the owning thread
+        alignas (64) std::atomic<uint64_t> read_index { 0 };    /// Only written by the drain
+        std::atomic<uint64_t> num_dropped { 0 };
+        rt_log_entry entries[num_entries];
+    };
+
+    struct rt_log_state
+    {
+        // One queue per thread slot, allocated by start_rt_log and never freed
+        std::atomic<rt_log_queue*> queues { nullptr };
+        std::atomic<uint64_t> num_dropped_without_queue { 0 };
+
+        std::atomic<bool> should_stop { false };
+        rt_log_options options;
+        std::thread* thread = nullptr;
+        bool has_registered_exit_flush = false;
+
+        // Held whilst draining so flush_rt_log can drain from any thread
+        std::mutex drain_mutex;
+        std::vector<const rt_log_entry*> pending;
+        int64_t start_ns = 0;
+    };
+
+    rt_log_state& get_rt_log_state()
+    {
+        static rt_log_state state;
+        return state;
+    }
+
+    //==============================================================================
+    /** Writes all the queued messages in time order. This must be called with the drain lock held. */
+    void drain (rt_log_state& state, rt_log_queue* queues)
+    {
+        state.pending.clear();
+        uint64_t num_dropped = state.num_dropped_without_queue.exchange (0, std::memory_order_relaxed);
+
+        std::array<uint64_t, max_thread_slots> write_indices;
+
+        for (std::size_t i = 0; i < max_thread_slots; ++i)
+        {
+            auto& queue = queues[i];
+            write_indices[i] = queue.write_index.load (std::memory_order_acquire);
+            num_dropped += queue.num_dropped.exchange (0, std::memory_order_relaxed);
+
+            for (auto index = queue.read_index.load (std::memory_order_relaxed); index != write_indices[i]; ++index)
+                state.pending.push_back (&queue.entries[index % rt_log_queue::num_entries]);
+        }
+
+        std::stable_sort (state.pending.begin(), state.pending.end(),
+                          [] (auto a, auto b) { return a->time_ns < b->time_ns; });
+
+        line_buffer line;
+
+        auto flush_line = [&]
+        {
+            write_all (state.options.fd, line.data, line.size);
+            line.size = 0;
+        };
+
+        for (auto entry : state.pending)
+        {
+            if (line.size > sizeof (line.data) - sizeof (entry->text) - 64)
+                flush_line();
+
+            line.append ("[%.3f ms, thread %llu] %s\n",
+                         static_cast<double> (entry->time_ns - state.start_ns) / 1.0e6,
+                         static_cast<unsigned long long> (entry->thread_id), entry->text);
+        }
+
+        if (num_dropped > 0)
+            line.append ("rt_log: %llu messages dropped as the queue was full or rt_log wasn't started\n",
+                         static_cast<unsigned long long> (num_dropped));
+
+        if (line.size > 0)
+            flush_line();
+
+        // Only free the entries once they've been written
+        for (std::size_t i = 0; i < max_thread_slots; ++i)
+            queues[i].read_index.store (write_indices[i], std::memory_order_release);
+    }
+
+    void drain_if_started()
+    {
+        auto& state = get_rt_log_state();
+
+        if (auto queues = state.queues.load (std::memory_order_acquire))
+        {
+            std::scoped_lock lock (state.drain_mutex);
+            drain (state, queues);
+        }
+    }
+
+    void run_drain()
+    {
+        auto& state = get_rt_log_state();
+
+        while (! state.should_stop.load (std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_for (state.options.poll_interval);
+            drain_if_started();
+        }
+    }
+}
+
+//==============================================================================
+void rt_log (const char* format, ...)
+{
+    auto& state = get_rt_log_state();
+    auto queues = state.queues.load (std::memory_order_acquire);
+    auto slot = get_thread_slot();
+
+    if (queues == nullptr || slot == nullptr)
+    {
+        state.num_dropped_without_queue.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& queue = queues[static_cast<std::size_t> (slot - get_thread_slots().data())];
+    const auto write_index = queue.write_index.load (std::memory_order_relaxed);
+
+    if (write_index - queue.read_index.load (std::memory_order_acquire) >= rt_log_queue::num_entries)
+    {
+        queue.num_dropped.store (queue.num_dropped.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& entry = queue.entries[write_index % rt_log_queue::num_entries];
+    entry.thread_id = slot->thread_id.load (std::memory_order_relaxed);
+    entry.time_ns = get_time_ns();
+
+    va_list args;
+    va_start (args, format);
+    std::vsnprintf (entry.text, sizeof (entry.text), format, args);
+    va_end (args);
+
+    queue.write_index.store (write_index + 1, std::memory_order_release);
+}
+
+bool start_rt_log (rt_log_options options)
+{
+    auto& state = get_rt_log_state();
+
+    if (state.thread != nullptr)
+        return false;
+
+    {
+        std::scoped_lock lock (state.drain_mutex);
+        state.options = options;
+        state.pending.reserve (max_thread_slots * rt_log_queue::num_entries);
+
+        if (state.queues.load (std::memory_order_relaxed) == nullptr)
+        {
+            state.start_ns = get_time_ns();
+            state.queues.store (new rt_log_queue[max_thread_slots], std::memory_order_release);
+        }
+    }
+
+    if (! state.has_registered_exit_flush)
+    {
+        state.has_registered_exit_flush = true;
+        std::atexit (flush_rt_log);
+    }
+
+    state.should_stop.store (false, std::memory_order_relaxed);
+    state.thread = new std::thread (run_drain);
+
+    return true;
+}
+
+void stop_rt_log()
+{
+    auto& state = get_rt_log_state();
+
+    if (state.thread == nullptr)
+        return;
+
+    state.should_stop.store (true, std::memory_order_relaxed);
+    state.thread->join();
+    delete state.thread;
+    state.thread = nullptr;
+
+    drain_if_started();
+}
+
+void flush_rt_log()
+{
+    drain_if_started();
+}
+}
@@ -1,119 +1,119 @@
 #include <dlfcn.h>
 #include <stdarg.h>
 #include <utility>
-#include <bitset>
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <numeric>
 #include <atomic>
 #include <execinfo.h>
-#include <regex>
+#include <new>
+#include <cstring>
+#include <bit>
+#include <csignal>
+#include <cstdio>
+#include <optional>
+#include <poll.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/select.h>
+#include <unistd.h>
 
 #if __APPLE__
  #include <libkern/OSAtomic.h>
  #include <os/lock.h>
  #include <malloc/malloc.h>
-#endif
-
-#if __has_include (<cxxabi.h>)
- #include <cxxabi.h>
+#else
+ #include <link.h>
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+ #include <sys/epoll.h>
+ #include <malloc.h>
 #endif
 
 #include "rtcheck.h"
+#include "rtcheck_internal.h"
 #include "interception.h"
 
 namespace rtc
 {
-auto to_underlying (auto e)
-{
-    return static_cast<std::underlying_type_t<decltype(e)>> (e);
-}
-
-inline std::string demangle (const std::string& name)
-{
-   #if __has_include(<cxxabi.h>)
-    int status;
-    std::unique_ptr<char, decltype (&std::free)> demangled (
-        abi::__cxa_demangle (name.c_str(), nullptr, nullptr, &status),
-        &std::free);
-
-    if (demangled && status == 0)
-        return std::string (demangled.get());
-   #endif
+//==============================================================================
+//==============================================================================
+static volatile bool has_initialised = false;
 
-    return name;
-}
 
-inline std::string extract_symbol (const std::string& line)
+//==============================================================================
+//==============================================================================
+/**
+    Used to enable intercepting of allocations using new, new[], delete and
+    delete[] on the calling thread.
+*/
+struct realtime_context_state
 {
-    // macOS/BSD format: "frame binary address symbol + offset"
-    if (line.find ("0x") != std::string::npos)
-    {
-        std::regex macPattern (R"(^\s*\d+\s+\S+\s+0x[0-9a-fA-F]+\s+(.+?)(?:\s+\+\s+\d+)?$)");
-        std::smatch match;
+    realtime_context_state() = default;
 
-        if (std::regex_match (line, match, macPattern))
-            return match[1].str();
-    }
+    /// The number of labels kept for nested scopes, deeper scopes are still counted
+    static constexpr int max_labels = 16;
 
-    // Linux format: "binary(symbol+offset) [address]"
+    /// Enters a, possibly nested, real-time context
+    void realtime_enter (const char* label = nullptr)
     {
-        size_t lparen = line.find ('(');
-        size_t plus = line.find ('+', lparen);
+        const auto depth = realtime_depth.load();
 
-        if (lparen != std::string::npos && plus != std::string::npos)
-            return line.substr (lparen + 1, plus - lparen - 1);
-    }
-
-    return line;
-}
+        if (depth < max_labels)
+            labels[static_cast<std::size_t> (depth)] = label;
 
+        realtime_depth.store (depth + 1);
+    }
 
-inline std::string get_stacktrace()
-{
-    std::string result;
+    /// Exits the innermost real-time context
+    void realtime_exit()                { realtime_depth.store (realtime_depth.load() - 1); }
 
-    void* stack[128];
-    auto frames = backtrace (stack, 128);
-    char** frameStrings = backtrace_symbols (stack, frames);
+    /// Takes the thread out of its real-time contexts until resume is called, returning the previous base
+    int suspend()                       { return realtime_base.exchange (realtime_depth.load()); }
 
-    for (auto i = (decltype (frames)) 0; i < frames; ++i)
-        (result.append (i, ' ') += demangle (extract_symbol (frameStrings[i]))) += "\n";
+    /// Restores the real-time contexts that were suspended
+    void resume (int previous_base)     { realtime_base.store (previous_base); }
 
-    result += "\n";
-    ::free (frameStrings);
+    /// Returns true if this is in a real-time state
+    bool is_realtime_context() const
+    {
+        return is_realtime_flag_set()
+                || (group != nullptr && group_suspend_depth == 0 && group->is_in_cycle());
+    }
 
-    return result;
-}
+    /// Returns true if a realtime_context or realtime_token is active, regardless of any group
+    bool is_realtime_flag_set() const   { return realtime_depth.load() > realtime_base.load(); }
 
+    /// Returns the label of the innermost labelled scope that isn't suspended, if any
+    const char* get_innermost_label() const
+    {
+        for (auto i = std::min (realtime_depth.load(), max_labels) - 1; i >= realtime_base.load(); --i)
+            if (auto label = labels[static_cast<std::size_t> (i)])
+                return label;
 
-//==============================================================================
-//==============================================================================
-static volatile bool has_initialised = false;
+        return nullptr;
+    }
 
+    /// The realtime_token the thread is running on behalf of, if any
+    const realtime_token* active_token = nullptr;
 
-//==============================================================================
-//==============================================================================
-/**
-    Used to enable intercepting of allocations using new, new[], delete and
-    delete[] on the calling thread.
-*/
-struct realtime_context_state
-{
-    realtime_context_state() = default;
+    /// The realtime_group the thread has joined, if any
+    const realtime_group* group = nullptr;
 
-    /// Enters a real-time context
-    void realtime_enter()               { realtime_flag.store (true); }
+    /// The number of non_realtime_contexts taking the thread out of its group's cycle
+    int group_suspend_depth = 0;
 
-    /// Exits a real-time context
-    void realtime_exit()                { realtime_flag.store (false); }
-
-    /// Returns true if this is in a real-time state
-    bool is_realtime_context() const    { return realtime_flag.load(); }
+    /// The slot overhead is accumulated in whilst in a realtime_context with accounting enabled
+    thread_slot* overhead_slot = nullptr;
+    uint64_t realtime_start_ticks = 0;
+    bool in_overhead_hook = false;
 
     //==============================================================================
 private:
-    std::atomic<bool> realtime_flag { false };
+    // Scopes below the base have been suspended by a non_realtime_context
+    std::atomic<int> realtime_depth { 0 }, realtime_base { 0 };
+    std::array<const char*, max_labels> labels {};
 };
 
 
@@ -141,7 +141,11 @@ Type& get_thead_local_variable()
 
     auto make_tls_key = []
     {
-        [[ maybe_unused ]]auto res = pthread_key_create (&key, malloc_zone_wrapper::internal_free);
+        [[ maybe_unused ]]auto res = pthread_key_create (&key, [] (void* ptr)
+                                                         {
+                                                             static_cast<Type*> (ptr)->~Type();
+                                                             malloc_zone_wrapper::internal_free (ptr);
+                                                         });
         assert(res == 0);
     };
 
@@ -164,9 +168,9 @@ realtime_context_state& get_realtime_context_state()
     return get_thead_local_variable<realtime_context_state>();
 }
 
-std::bitset<64>& get_disabled_flags_for_thread()
+check_flags& get_disabled_flags_for_thread()
 {
-    return get_thead_local_variable<std::bitset<64>>();
+    return get_thead_local_variable<check_flags>();
 }
 #else
 realtime_context_state& get_realtime_context_state()
@@ -175,32 +179,439 @@ realtime_context_state& get_realtime_context_state()
     return rcs;
 }
 
-std::bitset<64>& get_disabled_flags_for_thread()
+check_flags& get_disabled_flags_for_thread()
 {
-    thread_local std::bitset<64> disabled_flags;
+    thread_local check_flags disabled_flags;
     return disabled_flags;
 }
 #endif
 
-realtime_context::realtime_context()
+//==============================================================================
+//==============================================================================
+uint64_t get_thread_id()
+{
+   #if __APPLE__
+    uint64_t tid = 0;
+    pthread_threadid_np (nullptr, &tid);
+    return tid;
+   #else
+    return static_cast<uint64_t> (gettid());
+   #endif
+}
+
+std::array<thread_slot, max_thread_slots>& get_thread_slots()
+{
+    static std::array<thread_slot, max_thread_slots> slots;
+    return slots;
+}
+
+/** Counts from threads that have exited or couldn't claim a slot. */
+violation_count_array& get_retired_violation_counts()
+{
+    static violation_count_array counts {};
+    return counts;
+}
+
+/** Violation counts for a labelled realtime_context, shared by all threads. */
+struct scope_violation_slot
+{
+    std::atomic<const char*> label { nullptr };
+    std::atomic<uint64_t> count { 0 }, baseline { 0 };
+};
+
+constexpr std::size_t max_scope_labels = 512;
+
+/** An open addressed table keyed by the label pointer so it can be updated without locking. */
+std::array<scope_violation_slot, max_scope_labels>& get_scope_violation_counts()
+{
+    static std::array<scope_violation_slot, max_scope_labels> counts;
+    return counts;
+}
+
+void increment_scope_violation_count (const char* label)
+{
+    auto& counts = get_scope_violation_counts();
+    const auto hash = (reinterpret_cast<std::uintptr_t> (label) >> 3) * 0x9e3779b97f4a7c15ull;
+
+    for (std::size_t i = 0; i < max_scope_labels; ++i)
+    {
+        auto& slot = counts[(hash + i) % max_scope_labels];
+        auto current = slot.label.load (std::memory_order_acquire);
+
+        if (current == nullptr && slot.label.compare_exchange_strong (current, label, std::memory_order_acq_rel))
+            current = label;
+
+        if (current == label)
+        {
+            slot.count.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    // The table is full so this label isn't counted, the per-check counts still are
+}
+
+/** Returns a slot's count for a check, including stalls counted by the watchdog. */
+uint64_t load_violation_count (const thread_slot& slot, std::size_t index)
 {
-    get_realtime_context_state().realtime_enter();
+    const auto count = slot.violation_counts[index].load (std::memory_order_relaxed);
+
+    if (index == get_check_index (check_flags::stall))
+        return count + slot.stall_count.load (std::memory_order_relaxed);
+
+    return count;
+}
+
+thread_slot* claim_thread_slot()
+{
+    for (auto& slot : get_thread_slots())
+    {
+        if (bool expected = false;
+            slot.in_use.load (std::memory_order_relaxed) == expected
+            && slot.in_use.compare_exchange_strong (expected, true, std::memory_order_acquire))
+        {
+            slot.thread_id.store (get_thread_id(), std::memory_order_relaxed);
+            slot.thread = pthread_self();
+            slot.stall_captured.store (slot.stall_requested.load (std::memory_order_relaxed), std::memory_order_relaxed);
+            slot.prepared_stack_bytes = 0;
+            slot.preparation_check_generation = 0;
+            clear_cycle_stats (slot);
+
+            // The watchdog may have counted a stall after the previous owner released the slot
+            if (const auto stalls = slot.stall_count.exchange (0, std::memory_order_relaxed); stalls > 0)
+                get_retired_violation_counts()[get_check_index (check_flags::stall)].fetch_add (stalls, std::memory_order_relaxed);
+
+            return &slot;
+        }
+    }
+
+    return nullptr;
+}
+
+void release_thread_slot (thread_slot& slot)
+{
+    profiler_release_thread (slot);
+    overhead_release_thread (slot);
+
+    auto& retired = get_retired_violation_counts();
+
+    for (std::size_t i = 0; i < num_checks; ++i)
+    {
+        auto count = slot.violation_counts[i].exchange (0, std::memory_order_relaxed);
+
+        if (i == get_check_index (check_flags::stall))
+            count += slot.stall_count.exchange (0, std::memory_order_relaxed);
+
+        const auto baseline = slot.violation_baseline[i].exchange (0, std::memory_order_relaxed);
+
+        if (count > baseline)
+            retired[i].fetch_add (count - baseline, std::memory_order_relaxed);
+    }
+
+    slot.thread_id.store (0, std::memory_order_relaxed);
+    slot.in_use.store (false, std::memory_order_release);
+}
+
+struct thread_slot_owner
+{
+    ~thread_slot_owner()
+    {
+        if (slot != nullptr)
+            release_thread_slot (*slot);
+    }
+
+    thread_slot* slot = nullptr;
+    bool claim_failed = false;
+};
+
+#if __APPLE__
+thread_slot_owner& get_thread_slot_owner()
+{
+    return get_thead_local_variable<thread_slot_owner>();
+}
+#else
+thread_slot_owner& get_thread_slot_owner()
+{
+    thread_local thread_slot_owner owner;
+    return owner;
+}
+#endif
+
+/** Returns the slot for the calling thread, claiming one if necessary.
+    This can return nullptr if all the slots are in use.
+*/
+thread_slot* get_thread_slot_if_claimed()
+{
+    return get_thread_slot_owner().slot;
+}
+
+thread_slot* get_thread_slot()
+{
+    // The first access to the thread_local can allocate when registering its destructor
+    std::optional<non_realtime_context> nrc;
+
+    if (is_real_time_context())
+        nrc.emplace();
+
+    auto& owner = get_thread_slot_owner();
+
+    if (owner.slot == nullptr && ! owner.claim_failed)
+    {
+        owner.slot = claim_thread_slot();
+        owner.claim_failed = owner.slot == nullptr;
+    }
+
+    return owner.slot;
+}
+
+void increment_violation_count (thread_slot& slot, check_flags flag)
+{
+    auto& count = slot.violation_counts[get_check_index (flag)];
+    count.store (count.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void increment_stall_count (thread_slot& slot)
+{
+    slot.stall_count.fetch_add (1, std::memory_order_relaxed);
+}
+
+void increment_violation_count (check_flags flag)
+{
+    if (auto slot = get_thread_slot())
+        increment_violation_count (*slot, flag);
+    else
+        get_retired_violation_counts()[get_check_index (flag)].fetch_add (1, std::memory_order_relaxed);
+}
+
+violation_counts get_violation_counts (const thread_slot& slot)
+{
+    violation_counts result;
+
+    for (std::size_t i = 0; i < num_checks; ++i)
+    {
+        const auto count = load_violation_count (slot, i);
+        const auto baseline = slot.violation_baseline[i].load (std::memory_order_relaxed);
+        result.counts[i] = count > baseline ? count - baseline : 0;
+    }
+
+    return result;
+}
+
+//==============================================================================
+uint64_t violation_counts::get (check_flags flags) const
+{
+    uint64_t result = 0;
+
+    for (std::size_t i = 0; i < num_checks; ++i)
+        if (flags.test (i))
+            result += counts[i];
+
+    return result;
+}
+
+uint64_t violation_counts::total() const
+{
+    return std::accumulate (counts.begin(), counts.end(), uint64_t (0));
+}
+
+violation_stats get_violation_stats()
+{
+    violation_stats stats;
+    auto& retired = get_retired_violation_counts();
+
+    for (std::size_t i = 0; i < num_checks; ++i)
+        stats.total.counts[i] = retired[i].load (std::memory_order_relaxed);
+
+    for (auto& slot : get_thread_slots())
+    {
+        if (! slot.in_use.load (std::memory_order_relaxed))
+            continue;
+
+        const auto counts = get_violation_counts (slot);
+
+        if (counts.total() == 0)
+            continue;
+
+        for (std::size_t i = 0; i < num_checks; ++i)
+            stats.total.counts[i] += counts.counts[i];
+
+        stats.threads.push_back ({ slot.thread_id.load (std::memory_order_relaxed), counts });
+    }
+
+    for (auto& slot : get_scope_violation_counts())
+    {
+        const auto label = slot.label.load (std::memory_order_acquire);
+        const auto count = slot.count.load (std::memory_order_relaxed) - slot.baseline.load (std::memory_order_relaxed);
+
+        if (label == nullptr || count == 0)
+            continue;
+
+        // The same label can have different addresses in different modules
+        auto existing = std::find_if (stats.scopes.begin(), stats.scopes.end(),
+                                      [label] (auto& s) { return std::strcmp (s.label, label) == 0; });
+
+        if (existing != stats.scopes.end())
+            existing->count += count;
+        else
+            stats.scopes.push_back ({ label, count });
+    }
+
+    return stats;
+}
+
+violation_counts get_violation_stats_for_thread()
+{
+    if (auto slot = get_thread_slot())
+        return get_violation_counts (*slot);
+
+    return {};
+}
+
+void reset_violation_stats()
+{
+    for (auto& count : get_retired_violation_counts())
+        count.store (0, std::memory_order_relaxed);
+
+    for (auto& slot : get_thread_slots())
+        for (std::size_t i = 0; i < num_checks; ++i)
+            slot.violation_baseline[i].store (load_violation_count (slot, i), std::memory_order_relaxed);
+
+    for (auto& slot : get_scope_violation_counts())
+        slot.baseline.store (slot.count.load (std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+
+//==============================================================================
+//==============================================================================
+/** Times part of rtcheck when overhead accounting is enabled.
+    Nested hooks, such as an allocation made by a violation handler, are included
+    in the outer hook's time rather than being counted twice.
+*/
+struct overhead_scope
+{
+    [[gnu::always_inline]] explicit overhead_scope (overhead_category c)
+    {
+        if (! overhead_accounting_enabled.load (std::memory_order_relaxed))
+            return;
+
+        auto& s = get_realtime_context_state();
+
+        if (s.overhead_slot == nullptr || (c == overhead_category::hook && s.in_overhead_hook))
+            return;
+
+        if (c == overhead_category::hook)
+            s.in_overhead_hook = true;
+
+        state = &s;
+        category = c;
+        start_ticks = read_cycle_counter();
+    }
+
+    [[gnu::always_inline]] ~overhead_scope()
+    {
+        if (state == nullptr)
+            return;
+
+        const auto ticks = read_cycle_counter() - start_ticks;
+
+        if (category == overhead_category::hook)
+            state->in_overhead_hook = false;
+
+        if (state->overhead_slot != nullptr)
+            add_overhead (*state->overhead_slot, category, ticks);
+    }
+
+    overhead_scope (const overhead_scope&) = delete;
+    overhead_scope& operator= (const overhead_scope&) = delete;
+
+    realtime_context_state* state = nullptr;
+    overhead_category category = overhead_category::hook;
+    uint64_t start_ticks = 0;
+};
+
+void overhead_scope_enter (realtime_context_state& state)
+{
+    if (! overhead_accounting_enabled.load (std::memory_order_relaxed))
+        return;
+
+    // This claims the slot before entering the real-time context
+    state.overhead_slot = get_thread_slot();
+    state.realtime_start_ticks = read_cycle_counter();
+}
+
+void overhead_scope_exit (realtime_context_state& state)
+{
+    if (auto slot = std::exchange (state.overhead_slot, nullptr))
+        add_overhead (*slot, overhead_category::realtime_scope, read_cycle_counter() - state.realtime_start_ticks);
+}
+
+//==============================================================================
+realtime_context::realtime_context (const char* label)
+{
+    auto& state = get_realtime_context_state();
+
+    // Nested scopes are timed as part of the outermost one
+    if (state.is_realtime_flag_set())
+    {
+        lazy_binding_check();
+        state.realtime_enter (label);
+        return;
+    }
+
+    overhead_scope_enter (state);
+    watchdog_scope_enter();
+    profiler_scope_enter();
+    lazy_binding_check();
+    state.realtime_enter (label);
+    thread_preparation_check();
 }
 
 realtime_context::~realtime_context()
 {
-    get_realtime_context_state().realtime_exit();
+    auto& state = get_realtime_context_state();
+    lazy_binding_check();
+    state.realtime_exit();
+
+    if (state.is_realtime_flag_set())
+        return;
+
+    profiler_scope_exit();
+    watchdog_scope_exit();
+    overhead_scope_exit (state);
 }
 
 non_realtime_context::non_realtime_context()
 {
-    assert (get_realtime_context_state().is_realtime_context());
-    get_realtime_context_state().realtime_exit();
+    auto& state = get_realtime_context_state();
+    assert (state.is_realtime_context());
+
+    // The thread may only be real-time because its group is in a cycle
+    was_realtime_flag_set = state.is_realtime_flag_set();
+    ++state.group_suspend_depth;
+
+    lazy_binding_check();
+    previous_base = state.suspend();
+
+    if (was_realtime_flag_set)
+    {
+        profiler_scope_exit();
+        watchdog_scope_exit();
+    }
 }
 
 non_realtime_context::~non_realtime_context()
 {
-    get_realtime_context_state().realtime_enter();
+    auto& state = get_realtime_context_state();
+
+    if (was_realtime_flag_set)
+    {
+        watchdog_scope_enter();
+        profiler_scope_enter();
+    }
+
+    lazy_binding_check();
+    --state.group_suspend_depth;
+    state.resume (previous_base);
 }
 
 bool is_real_time_context()
@@ -208,45 +619,256 @@ bool is_real_time_context()
     return get_realtime_context_state().is_realtime_context();
 }
 
-void log_function_if_realtime_context (const char* function_name)
+//==============================================================================
+void realtime_group::join()
+{
+    get_realtime_context_state().group = this;
+}
+
+void realtime_group::leave()
+{
+    get_realtime_context_state().group = nullptr;
+}
+
+//==============================================================================
+realtime_token::realtime_token (const char* l, std::source_location o)
+    : label (l), origin (o)
+{
+}
+
+realtime_token::realtime_token (realtime_token&& other) noexcept
+    : label (other.label), origin (other.origin)
+{
+}
+
+realtime_token& realtime_token::operator= (realtime_token&& other) noexcept
+{
+    label = other.label;
+    origin = other.origin;
+    return *this;
+}
+
+void realtime_token::activate()
+{
+    auto& state = get_realtime_context_state();
+    previous_token = state.active_token;
+    state.active_token = this;
+    state.realtime_enter();
+}
+
+void realtime_token::deactivate()
+{
+    auto& state = get_realtime_context_state();
+    state.realtime_exit();
+    state.active_token = previous_token;
+}
+
+//==============================================================================
+/** Formats a description of the violation in to dest without allocating. */
+void format_violation_message (char* dest, std::size_t dest_size, std::string_view function_name, const call_details& details)
+{
+    auto written = std::snprintf (dest, dest_size, "Real-time violation: intercepted call to real-time unsafe function %.*s",
+                                  static_cast<int> (function_name.size()), function_name.data());
+
+    auto append = [&] (const char* format, auto... args)
+    {
+        if (written >= 0 && static_cast<std::size_t> (written) < dest_size)
+            written += std::snprintf (dest + written, dest_size - static_cast<std::size_t> (written), format, args...);
+    };
+
+    if (details.size > 0 && details.alignment > 0)
+        append (" (size: %zu, alignment: %zu)", details.size, details.alignment);
+    else if (details.size > 0)
+        append (" (size: %zu)", details.size);
+    else if (details.alignment > 0)
+        append (" (alignment: %zu)", details.alignment);
+
+    if (details.zero_timeout)
+        append (" with a zero timeout");
+
+    append (" in real-time context!");
+}
+
+std::atomic<violation_handler>& get_violation_handler()
+{
+    static std::atomic<violation_handler> handler { nullptr };
+    return handler;
+}
+
+std::atomic<void*>& get_violation_handler_user_data()
+{
+    static std::atomic<void*> user_data { nullptr };
+    return user_data;
+}
+
+void set_violation_handler (violation_handler handler, void* user_data)
+{
+    get_violation_handler_user_data().store (user_data, std::memory_order_relaxed);
+    get_violation_handler().store (handler, std::memory_order_release);
+}
+
+void report_violation (const violation_record& record, error_mode mode)
+{
+    if (mode == error_mode::callback)
+    {
+        if (auto handler = get_violation_handler().load (std::memory_order_acquire))
+        {
+            handler (record, get_violation_handler_user_data().load (std::memory_order_relaxed));
+            return;
+        }
+    }
+
+    // The stack is symbolicated offline from the log if there is one
+    line_buffer line;
+
+    if (is_violation_log_enabled())
+    {
+        line.append ("%s\n", record.message);
+        write_all (STDERR_FILENO, line.data, line.size);
+    }
+    else
+    {
+        line.append ("%s Stack trace:\n", record.message);
+        write_all (STDERR_FILENO, line.data, line.size);
+        write_stacktrace (STDERR_FILENO, record.frames.data(), record.num_frames);
+    }
+
+    if (mode == error_mode::exit)
+        std::exit (1);
+}
+
+/** Returns the caller of the intercepted function or, if that isn't known, a hash of the stack. */
+std::uintptr_t get_violation_site (const call_details& details, void* const* frames, std::size_t num_frames)
+{
+    if (details.caller != nullptr)
+        return reinterpret_cast<std::uintptr_t> (details.caller);
+
+    std::uintptr_t hash = 0;
+
+    for (std::size_t i = 0; i < num_frames; ++i)
+        hash = (hash ^ reinterpret_cast<std::uintptr_t> (frames[i])) * 0x100000001b3ull;
+
+    return hash;
+}
+
+uint64_t log_violation (check_flags flag, const char* function_name, const call_details& details, const char* message)
 {
     if (! has_initialised)
-        return;
+        return 0;
 
     if (! is_real_time_context())
-        return;
+        return 0;
+
+    const auto policy = get_check_policy (static_cast<check_id> (get_check_index (flag)));
+
+    if (policy == check_policy::ignore)
+        return 0;
+
+    // This is read before leaving the real-time context which suspends the labels
+    const auto scope_label = get_realtime_context_state().get_innermost_label();
+
+    if (policy == check_policy::count)
+    {
+        increment_violation_count (flag);
+
+        if (scope_label != nullptr)
+            increment_scope_violation_count (scope_label);
+
+        return 0;
+    }
 
     non_realtime_context nrc;
 
+    violation_record record;
+
+    {
+        overhead_scope overhead (overhead_category::stack_capture);
+        record.num_frames = static_cast<std::size_t> (backtrace (record.frames.data(), static_cast<int> (record.frames.size())));
+    }
+
+    if (is_suppressed (flag, record.frames.data(), record.num_frames))
+        return 0;
+
+    increment_violation_count (flag);
+
+    if (scope_label != nullptr)
+        increment_scope_violation_count (scope_label);
+
+    if (policy == check_policy::log_once
+        && ! is_first_violation_at_site (flag, get_violation_site (details, record.frames.data(), record.num_frames)))
+        return 0;
+
+    const auto mode = get_error_mode_for_policy (policy, get_error_mode_for_thread());
+
+    if (mode == error_mode::trap)
+    {
+        std::raise (SIGTRAP);
+        return 0;
+    }
+
     std::string_view name (function_name), wrap_prefix ("wrap_");
 
     if (name.starts_with (wrap_prefix))
         name = name.substr (wrap_prefix.length());
 
-    std::cerr << "Real-time violation: intercepted call to real-time unsafe function " << name << " in real-time context! Stack trace:\n" << get_stacktrace() << std::endl;
+    record.check = flag;
+    record.function_name = name.data();
+    record.thread_id = get_thread_id();
+    record.size = details.size;
+    record.alignment = details.alignment;
+    record.token = get_realtime_context_state().active_token;
+    record.scope_label = scope_label;
 
-    if (get_error_mode() == error_mode::exit)
-        std::exit (1);
+    if (message != nullptr)
+        std::snprintf (record.message, sizeof (record.message), "%s", message);
+    else
+        format_violation_message (record.message, sizeof (record.message), name, details);
+
+    if (scope_label != nullptr)
+    {
+        const auto length = std::strlen (record.message);
+        std::snprintf (record.message + length, sizeof (record.message) - length,
+                       " In realtime_context \"%s\".", scope_label);
+    }
+
+    if (const auto token = record.token)
+    {
+        const auto length = std::strlen (record.message);
+        std::snprintf (record.message + length, sizeof (record.message) - length,
+                       " In realtime_token \"%s\" created at %s:%u.",
+                       token->label != nullptr ? token->label : "", token->origin.file_name(),
+                       static_cast<unsigned> (token->origin.line()));
+    }
+
+    overhead_scope overhead (overhead_category::reporting);
+    const auto log_id = write_violation_log_record (record);
+    report_violation (record, mode);
+
+    return log_id;
+}
+
+void log_function_if_realtime_context (const char* function_name)
+{
+    overhead_scope overhead (overhead_category::hook);
+
+    if (is_check_enabled_for_thread (check_flags::custom))
+        log_violation (check_flags::custom, function_name, { .caller = __builtin_return_address (0) });
 }
 
 //==============================================================================
 void disable_checks_for_thread (uint64_t flags)
 {
-    get_disabled_flags_for_thread() = flags;
+    disable_checks_for_thread (check_flags::from_bits (flags));
 }
 
 void disable_checks_for_thread (check_flags flags)
 {
-    disable_checks_for_thread(static_cast<uint64_t> (flags));
+    get_disabled_flags_for_thread() = flags;
 }
 
-bool are_all_bits_enabled (uint64_t flags, std::bitset<64> disabled_bits)
+bool are_all_checks_enabled (check_flags checks, check_flags disabled_checks)
 {
-    assert(static_cast<uint64_t> (flags) <= std::numeric_limits<uint64_t>::max());
-    const std::bitset<64> bits (flags);
-    const auto disabled_bits_interested_in = disabled_bits & bits;
-
-    return (bits ^ disabled_bits_interested_in) == bits;
+    return ! checks.intersects (disabled_checks);
 }
 
 #ifndef NDEBUG
@@ -254,23 +876,38 @@ struct check_flags_tests
 {
     check_flags_tests()
     {
-        assert(! are_all_bits_enabled (to_underlying (check_flags::malloc), 0b1));
-        assert(! are_all_bits_enabled (to_underlying (check_flags::malloc) + to_underlying (check_flags::realloc), 0b101));
-        assert(are_all_bits_enabled (to_underlying (check_flags::malloc) + to_underlying (check_flags::calloc), 0b100));
-        assert(are_all_bits_enabled (to_underlying (check_flags::syscall) + to_underlying (check_flags::openat), 0b0));
-        auto a1 = to_underlying (check_flags::syscall);
-        auto a2 = to_underlying (check_flags::openat);
-        assert(! are_all_bits_enabled (to_underlying (check_flags::syscall) + to_underlying (check_flags::openat), 0b100010000000000000000000000000000000000));
+        assert(! are_all_checks_enabled (check_flags::malloc, check_flags::from_bits (0b1)));
+        assert(! are_all_checks_enabled (check_flags::malloc | check_flags::realloc, check_flags::from_bits (0b101)));
+        assert(are_all_checks_enabled (check_flags::malloc | check_flags::calloc, check_flags::from_bits (0b100)));
+        assert(are_all_checks_enabled (check_flags::syscall | check_flags::openat, check_flags()));
+        assert(! are_all_checks_enabled (check_flags::syscall | check_flags::openat, check_flags::from_bits ((1ull << 38) | (1ull << 34))));
+
+        // Checks past the first word
+        check_flags high;
+        high.set (100);
+        assert(! are_all_checks_enabled (high, high));
+        assert(are_all_checks_enabled (check_flags::malloc, high));
+        assert((check_flags::all() & high).none());
     }
 };
 
 static check_flags_tests check_flags_tests;
 #endif
 
+/** Returns true if a single check is enabled for the calling thread.
+    This is inlined so a constant check is one load of its word and a mask.
+*/
+[[gnu::always_inline]] inline bool is_check_enabled_for_thread (check_id check)
+{
+    return ! get_disabled_flags_for_thread().test (static_cast<std::size_t> (check));
+}
+
 bool is_check_enabled_for_thread (check_flags check)
 {
-    assert(std::bitset<64> (static_cast<uint64_t> (check)).count() == 1 && "Only one flag can be check with this function");
-    return are_all_bits_enabled (static_cast<uint64_t> (check), get_disabled_flags_for_thread());
+    assert (std::accumulate (std::begin (check.words), std::end (check.words), 0,
+                             [] (int total, uint64_t word) { return total + std::popcount (word); }) == 1
+            && "Only one flag can be checked with this function");
+    return ! get_disabled_flags_for_thread().test (get_check_index (check));
 }
 
 
@@ -283,33 +920,98 @@ std::atomic<error_mode>& get_error_mode_flag()
     return em;
 }
 
-void set_error_mode (error_mode em)
-{
-    get_error_mode_flag().store (em, std::memory_order_release);
+void set_error_mode (error_mode em)
+{
+    get_error_mode_flag().store (em, std::memory_order_release);
+}
+
+error_mode get_error_mode()
+{
+    return get_error_mode_flag().load (std::memory_order_acquire);
+}
+
+#if __APPLE__
+std::optional<error_mode>& get_error_mode_override_for_thread()
+{
+    return get_thead_local_variable<std::optional<error_mode>>();
+}
+#else
+std::optional<error_mode>& get_error_mode_override_for_thread()
+{
+    thread_local std::optional<error_mode> em;
+    return em;
+}
+#endif
+
+void set_error_mode_for_thread (error_mode em)
+{
+    get_error_mode_override_for_thread() = em;
+}
+
+void reset_error_mode_for_thread()
+{
+    get_error_mode_override_for_thread().reset();
+}
+
+error_mode get_error_mode_for_thread()
+{
+    if (auto em = get_error_mode_override_for_thread())
+        return *em;
+
+    return get_error_mode();
+}
+}
+
+/** Logs a violation if the calling thread is in a real-time context, the check is
+    enabled and the intercepted function wasn't called from trusted code.
+    The returned scope should be kept until the intercepted call returns so its
+    cost can be written to the violation log.
+*/
+[[nodiscard, gnu::always_inline]] inline rtc::violation_cost_scope log_function_if_realtime_context_and_enabled (rtc::check_id check, const char* function_name,
+                                                                                                                 const rtc::call_details& details = {})
+{
+    if (! rtc::has_initialised)
+        return {};
+
+    rtc::overhead_scope overhead (rtc::overhead_category::hook);
+
+    // This is inlined so the return address is the interceptor's caller
+    if (rtc::is_check_enabled_for_thread (check) && rtc::is_real_time_context()
+        && ! rtc::is_trusted_caller (__builtin_return_address (0)))
+    {
+        auto site_details = details;
+        site_details.caller = __builtin_return_address (0);
+        return rtc::violation_cost_scope (rtc::log_violation (check, function_name, site_details));
+    }
+
+    return {};
 }
 
-error_mode get_error_mode()
+/** Reports a wait that has a zero timeout as check_id::nonblocking_wait rather than its own check.
+    These can't deschedule the thread for long so can be disabled separately to the blocking waits.
+*/
+[[nodiscard, gnu::always_inline]] inline rtc::violation_cost_scope log_wait_if_realtime_context_and_enabled (rtc::check_id check, const char* function_name,
+                                                                                                             bool zero_timeout)
 {
-    return get_error_mode_flag().load (std::memory_order_acquire);
-}
-}
+    if (! zero_timeout)
+        return log_function_if_realtime_context_and_enabled (check, function_name);
 
-void log_function_if_realtime_context_and_enabled (rtc::check_flags flag, const char* function_name)
-{
-    if (! rtc::has_initialised)
-        return;
+    if (! rtc::has_initialised || ! rtc::is_check_enabled_for_thread (check))
+        return {};
 
-    if (rtc::is_check_enabled_for_thread (flag))
-        rtc::log_function_if_realtime_context (function_name);
+    return log_function_if_realtime_context_and_enabled (rtc::check_id::nonblocking_wait, function_name, { .zero_timeout = true });
 }
 
+constexpr bool is_zero (const timespec* t)  { return t != nullptr && t->tv_sec == 0 && t->tv_nsec == 0; }
+constexpr bool is_zero (const timeval* t)   { return t != nullptr && t->tv_sec == 0 && t->tv_usec == 0; }
+
 
 //==============================================================================
 // memory
 //==============================================================================
 INTERCEPTOR(void*, malloc, size_t size)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::malloc, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::malloc, __func__, { .size = size });
     INTERCEPT_FUNCTION(void*, malloc, size_t);
 
     return REAL(malloc)(size);
@@ -318,7 +1020,7 @@ INTERCEPTOR(void*, malloc, size_t size)
 
 INTERCEPTOR(void*, calloc, size_t size, size_t item_size)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::calloc, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::calloc, __func__, { .size = size * item_size });
 
     INTERCEPT_FUNCTION(void*, calloc, size_t, size_t);
     return REAL(calloc)(size, item_size);
@@ -326,7 +1028,7 @@ INTERCEPTOR(void*, calloc, size_t size, size_t item_size)
 
 INTERCEPTOR(void*, realloc, void *ptr, size_t new_size)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::realloc, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::realloc, __func__, { .size = new_size });
 
     INTERCEPT_FUNCTION(void*, realloc, void*, size_t);
     return REAL(realloc)(ptr, new_size);
@@ -335,7 +1037,7 @@ INTERCEPTOR(void*, realloc, void *ptr, size_t new_size)
 #ifdef __APPLE__
 INTERCEPTOR(void *, reallocf, void *ptr, size_t size)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::reallocf, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::reallocf, __func__, { .size = size });
 
     INTERCEPT_FUNCTION(void*, reallocf, void*, size_t);
     return REAL(reallocf)(ptr, size);
@@ -344,7 +1046,7 @@ INTERCEPTOR(void *, reallocf, void *ptr, size_t size)
 
 INTERCEPTOR(void*, valloc, size_t size)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::valloc, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::valloc, __func__, { .size = size });
 
     INTERCEPT_FUNCTION(void*, valloc, size_t);
     return REAL(valloc)(size);
@@ -352,8 +1054,8 @@ INTERCEPTOR(void*, valloc, size_t size)
 
 INTERCEPTOR(void, free, void* ptr)
 {
-    if (ptr != nullptr)
-        log_function_if_realtime_context_and_enabled (rtc::check_flags::free, __func__);
+    const auto cost_scope = ptr != nullptr ? log_function_if_realtime_context_and_enabled (rtc::check_id::free, __func__)
+                                           : rtc::violation_cost_scope();
 
     INTERCEPT_FUNCTION(void, free, void*);
     return REAL(free)(ptr);
@@ -361,7 +1063,7 @@ INTERCEPTOR(void, free, void* ptr)
 
 INTERCEPTOR(int, posix_memalign, void **memptr, size_t alignment, size_t size)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::posix_memalign, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::posix_memalign, __func__, { .size = size, .alignment = alignment });
 
     INTERCEPT_FUNCTION(int, posix_memalign, void**, size_t, size_t);
     return REAL(posix_memalign)(memptr, alignment, size);
@@ -369,7 +1071,7 @@ INTERCEPTOR(int, posix_memalign, void **memptr, size_t alignment, size_t size)
 
 INTERCEPTOR(void *, mmap, void* addr, size_t length, int prot, int flags, int fd, off_t offset)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::mmap, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::mmap, __func__, { .size = length });
 
     INTERCEPT_FUNCTION(void*, mmap, void*, size_t, int, int, int, off_t);
     return REAL(mmap)(addr, length, prot, flags, fd, offset);
@@ -377,42 +1079,213 @@ INTERCEPTOR(void *, mmap, void* addr, size_t length, int prot, int flags, int fd
 
 INTERCEPTOR(int, munmap, void* addr, size_t length)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::munmap, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::munmap, __func__, { .size = length });
 
     INTERCEPT_FUNCTION(int, munmap, void*, size_t);
     return REAL(munmap)(addr, length);
 }
 
 
+INTERCEPTOR(void*, aligned_alloc, size_t alignment, size_t size)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::aligned_alloc, __func__, { .size = size, .alignment = alignment });
+
+    INTERCEPT_FUNCTION(void*, aligned_alloc, size_t, size_t);
+    return REAL(aligned_alloc)(alignment, size);
+}
+
+#ifndef __APPLE__
+INTERCEPTOR(void*, memalign, size_t alignment, size_t size)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::memalign, __func__, { .size = size, .alignment = alignment });
+
+    INTERCEPT_FUNCTION(void*, memalign, size_t, size_t);
+    return REAL(memalign)(alignment, size);
+}
+
+INTERCEPTOR(void*, pvalloc, size_t size)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pvalloc, __func__, { .size = size });
+
+    INTERCEPT_FUNCTION(void*, pvalloc, size_t);
+    return REAL(pvalloc)(size);
+}
+
+INTERCEPTOR(size_t, malloc_usable_size, void* ptr)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::malloc_usable_size, __func__);
+
+    INTERCEPT_FUNCTION(size_t, malloc_usable_size, void*);
+    return REAL(malloc_usable_size)(ptr);
+}
+#endif
+
+// strdup and strndup are implemented here rather than forwarded as libc's
+// versions call malloc internally which would report a second violation
+INTERCEPTOR(char*, strdup, const char* str)
+{
+    const auto size = std::strlen (str) + 1;
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::strdup, __func__, { .size = size });
+
+    INTERCEPT_FUNCTION(void*, malloc, size_t);
+
+    if (auto copy = static_cast<char*> (REAL(malloc)(size)))
+        return static_cast<char*> (std::memcpy (copy, str, size));
+
+    return nullptr;
+}
+
+INTERCEPTOR(char*, strndup, const char* str, size_t max_size)
+{
+    const auto length = strnlen (str, max_size);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::strndup, __func__, { .size = length + 1 });
+
+    INTERCEPT_FUNCTION(void*, malloc, size_t);
+
+    if (auto copy = static_cast<char*> (REAL(malloc)(length + 1)))
+    {
+        std::memcpy (copy, str, length);
+        copy[length] = '\0';
+        return copy;
+    }
+
+    return nullptr;
+}
+
+
+//==============================================================================
+// new/delete
+//==============================================================================
+// These are replaced directly rather than relying on them calling malloc/free
+// as some allocators (e.g. tcmalloc, jemalloc) don't route operator new through
+// malloc. The memory is obtained from the next malloc in the lookup order.
+namespace rtc
+{
+    void* allocate (std::size_t size, std::size_t alignment)
+    {
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        {
+            INTERCEPT_FUNCTION(void*, malloc, size_t);
+            return REAL(malloc)(size);
+        }
+
+        INTERCEPT_FUNCTION(int, posix_memalign, void**, size_t, size_t);
+        void* ptr = nullptr;
+
+        if (REAL(posix_memalign)(&ptr, std::max (alignment, sizeof (void*)), size) != 0)
+            return nullptr;
+
+        return ptr;
+    }
+
+    void deallocate (void* ptr)
+    {
+        INTERCEPT_FUNCTION(void, free, void*);
+        REAL(free)(ptr);
+    }
+
+    // These are inlined in to the global operators so the prologue sees their caller's return address
+    [[gnu::always_inline]] inline void* operator_new (const char* function_name, std::size_t size, std::size_t alignment = 0)
+    {
+        const auto cost_scope = log_function_if_realtime_context_and_enabled (check_id::operator_new, function_name, { .size = size, .alignment = alignment });
+
+        for (size = std::max (size, std::size_t (1));;)
+        {
+            if (auto ptr = allocate (size, alignment))
+                return ptr;
+
+            if (auto handler = std::get_new_handler())
+                handler();
+            else
+                throw std::bad_alloc();
+        }
+    }
+
+    [[gnu::always_inline]] inline void* operator_new_nothrow (const char* function_name, std::size_t size, std::size_t alignment = 0) noexcept
+    {
+        try
+        {
+            return operator_new (function_name, size, alignment);
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    [[gnu::always_inline]] inline void operator_delete (const char* function_name, void* ptr, std::size_t size = 0, std::size_t alignment = 0) noexcept
+    {
+        if (ptr == nullptr)
+            return;
+
+        const auto cost_scope = log_function_if_realtime_context_and_enabled (check_id::operator_delete, function_name, { .size = size, .alignment = alignment });
+        deallocate (ptr);
+    }
+}
+
+void* operator new (std::size_t size)                                           { return rtc::operator_new ("operator new", size); }
+void* operator new[] (std::size_t size)                                         { return rtc::operator_new ("operator new[]", size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept           { return rtc::operator_new_nothrow ("operator new", size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept         { return rtc::operator_new_nothrow ("operator new[]", size); }
+void* operator new (std::size_t size, std::align_val_t al)                      { return rtc::operator_new ("operator new", size, static_cast<std::size_t> (al)); }
+void* operator new[] (std::size_t size, std::align_val_t al)                    { return rtc::operator_new ("operator new[]", size, static_cast<std::size_t> (al)); }
+void* operator new (std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept      { return rtc::operator_new_nothrow ("operator new", size, static_cast<std::size_t> (al)); }
+void* operator new[] (std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept    { return rtc::operator_new_nothrow ("operator new[]", size, static_cast<std::size_t> (al)); }
+
+void operator delete (void* ptr) noexcept                                       { rtc::operator_delete ("operator delete", ptr); }
+void operator delete[] (void* ptr) noexcept                                     { rtc::operator_delete ("operator delete[]", ptr); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept                { rtc::operator_delete ("operator delete", ptr); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept              { rtc::operator_delete ("operator delete[]", ptr); }
+void operator delete (void* ptr, std::size_t size) noexcept                     { rtc::operator_delete ("operator delete", ptr, size); }
+void operator delete[] (void* ptr, std::size_t size) noexcept                   { rtc::operator_delete ("operator delete[]", ptr, size); }
+void operator delete (void* ptr, std::align_val_t al) noexcept                  { rtc::operator_delete ("operator delete", ptr, 0, static_cast<std::size_t> (al)); }
+void operator delete[] (void* ptr, std::align_val_t al) noexcept                { rtc::operator_delete ("operator delete[]", ptr, 0, static_cast<std::size_t> (al)); }
+void operator delete (void* ptr, std::align_val_t al, const std::nothrow_t&) noexcept           { rtc::operator_delete ("operator delete", ptr, 0, static_cast<std::size_t> (al)); }
+void operator delete[] (void* ptr, std::align_val_t al, const std::nothrow_t&) noexcept         { rtc::operator_delete ("operator delete[]", ptr, 0, static_cast<std::size_t> (al)); }
+void operator delete (void* ptr, std::size_t size, std::align_val_t al) noexcept                { rtc::operator_delete ("operator delete", ptr, size, static_cast<std::size_t> (al)); }
+void operator delete[] (void* ptr, std::size_t size, std::align_val_t al) noexcept              { rtc::operator_delete ("operator delete[]", ptr, size, static_cast<std::size_t> (al)); }
+
+
 //==============================================================================
 // threads
 //==============================================================================
 INTERCEPTOR(int, pthread_create, pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_create, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_create, __func__);
     INTERCEPT_FUNCTION(int, pthread_create, pthread_t *, const pthread_attr_t *, void *(*)(void *), void *);
     return REAL(pthread_create)(thread, attr, start_routine, arg);
 }
 
 INTERCEPTOR(int, pthread_mutex_lock, pthread_mutex_t *mutex)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_mutex_lock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_mutex_lock, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_mutex_lock, pthread_mutex_t*);
-    return REAL(pthread_mutex_lock)(mutex);
+
+    if (rtc::has_initialised && rtc::is_real_time_context()
+        && rtc::is_check_enabled_for_thread (rtc::check_id::priority_inversion))
+        return rtc::lock_mutex_checking_priority_inversion (mutex, REAL(pthread_mutex_lock));
+
+    const auto result = REAL(pthread_mutex_lock)(mutex);
+
+    if (result == 0)
+        rtc::mutex_locked (mutex);
+
+    return result;
 }
 
 INTERCEPTOR(int, pthread_mutex_unlock, pthread_mutex_t *mutex)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_mutex_unlock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_mutex_unlock, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_mutex_unlock, pthread_mutex_t*);
+    rtc::mutex_unlocked (mutex);
     return REAL(pthread_mutex_unlock)(mutex);
 }
 
 INTERCEPTOR(int, pthread_join, pthread_t thread, void **value_ptr)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_join, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_join, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_join, pthread_t, void **);
     return REAL(pthread_join)(thread, value_ptr);
@@ -420,7 +1293,7 @@ INTERCEPTOR(int, pthread_join, pthread_t thread, void **value_ptr)
 
 INTERCEPTOR(int, pthread_cond_signal, pthread_cond_t *cond)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_cond_signal, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_cond_signal, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_cond_signal, pthread_cond_t *);
     return REAL(pthread_cond_signal)(cond);
@@ -428,7 +1301,7 @@ INTERCEPTOR(int, pthread_cond_signal, pthread_cond_t *cond)
 
 INTERCEPTOR(int, pthread_cond_broadcast, pthread_cond_t *cond)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_cond_broadcast, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_cond_broadcast, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_cond_broadcast, pthread_cond_t *);
     return REAL(pthread_cond_broadcast)(cond);
@@ -436,7 +1309,7 @@ INTERCEPTOR(int, pthread_cond_broadcast, pthread_cond_t *cond)
 
 INTERCEPTOR(int, pthread_cond_wait, pthread_cond_t *cond, pthread_mutex_t *mutex)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_cond_wait, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_cond_wait, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_cond_wait, pthread_cond_t *, pthread_mutex_t *);
     return REAL(pthread_cond_wait)(cond, mutex);
@@ -445,7 +1318,7 @@ INTERCEPTOR(int, pthread_cond_wait, pthread_cond_t *cond, pthread_mutex_t *mutex
 INTERCEPTOR(int, pthread_rwlock_init, pthread_rwlock_t *rwlock,
             const pthread_rwlockattr_t *attr)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_rwlock_init, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_rwlock_init, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_rwlock_init, pthread_rwlock_t *, const pthread_rwlockattr_t *);
     return REAL(pthread_rwlock_init)(rwlock, attr);
@@ -453,7 +1326,7 @@ INTERCEPTOR(int, pthread_rwlock_init, pthread_rwlock_t *rwlock,
 
 INTERCEPTOR(int, pthread_rwlock_destroy, pthread_rwlock_t *rwlock)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_rwlock_destroy, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_rwlock_destroy, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_rwlock_destroy, pthread_rwlock_t *);
     return REAL(pthread_rwlock_destroy)(rwlock);
@@ -462,7 +1335,7 @@ INTERCEPTOR(int, pthread_rwlock_destroy, pthread_rwlock_t *rwlock)
 INTERCEPTOR(int, pthread_cond_timedwait, pthread_cond_t *cond,
             pthread_mutex_t *mutex, const timespec *ts)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_cond_timedwait, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_cond_timedwait, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_cond_timedwait, pthread_cond_t *,
                         pthread_mutex_t *, const timespec *);
@@ -471,7 +1344,7 @@ INTERCEPTOR(int, pthread_cond_timedwait, pthread_cond_t *cond,
 
 INTERCEPTOR(int, pthread_rwlock_rdlock, pthread_rwlock_t *lock)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_rwlock_rdlock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_rwlock_rdlock, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_rwlock_rdlock, pthread_rwlock_t *);
     return REAL(pthread_rwlock_rdlock)(lock);
@@ -479,7 +1352,7 @@ INTERCEPTOR(int, pthread_rwlock_rdlock, pthread_rwlock_t *lock)
 
 INTERCEPTOR(int, pthread_rwlock_unlock, pthread_rwlock_t *lock)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_rwlock_unlock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_rwlock_unlock, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_rwlock_unlock, pthread_rwlock_t *);
     return REAL(pthread_rwlock_unlock)(lock);
@@ -487,7 +1360,7 @@ INTERCEPTOR(int, pthread_rwlock_unlock, pthread_rwlock_t *lock)
 
 INTERCEPTOR(int, pthread_rwlock_wrlock, pthread_rwlock_t *lock)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_rwlock_wrlock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_rwlock_wrlock, __func__);
 
     INTERCEPT_FUNCTION(int, pthread_rwlock_wrlock, pthread_rwlock_t *);
     return REAL(pthread_rwlock_wrlock)(lock);
@@ -497,34 +1370,132 @@ INTERCEPTOR(int, pthread_rwlock_wrlock, pthread_rwlock_t *lock)
 #ifndef __APPLE__
 INTERCEPTOR(int, pthread_spin_lock, pthread_spinlock_t *spinlock)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::pthread_spin_lock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_spin_lock, __func__);
     INTERCEPT_FUNCTION(int, pthread_spin_lock, pthread_spinlock_t*);
     return REAL(pthread_spin_lock)(spinlock);
 }
+#endif
+
+//==============================================================================
+// atomics
+//==============================================================================
+#if __linux__
+// Atomics that aren't lock-free are implemented by libatomic, which may take a
+// lock. The entry points have the same names as compiler builtins so they're
+// defined here using asm labels.
+#define ATOMIC_INTERCEPTOR(ret_type, func, ...)                         \
+    extern "C" ret_type rtcheck##func(__VA_ARGS__) __asm__ (#func);     \
+    extern "C" INTERCEPTOR_ATTRIBUTE ret_type rtcheck##func(__VA_ARGS__)
+
+/** Logs an atomic operation if it isn't lock-free for the given object.
+    The lock-free query is only made once the cheaper checks have passed.
+*/
+[[nodiscard, gnu::always_inline]] inline rtc::violation_cost_scope log_atomic_if_realtime_context_and_enabled (const char* function_name, size_t size, const void* ptr)
+{
+    if (! rtc::has_initialised)
+        return {};
+
+    rtc::overhead_scope overhead (rtc::overhead_category::hook);
+
+    if (! rtc::is_check_enabled_for_thread (rtc::check_id::atomic) || ! rtc::is_real_time_context())
+        return {};
+
+    INTERCEPT_FUNCTION(bool, __atomic_is_lock_free, size_t, const void*);
+
+    if (REAL(__atomic_is_lock_free)(size, ptr))
+        return {};
+
+    return log_function_if_realtime_context_and_enabled (rtc::check_id::atomic, function_name, { .size = size });
+}
+
+ATOMIC_INTERCEPTOR(void, __atomic_load, size_t size, void* ptr, void* ret, int order)
+{
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_load", size, ptr);
+
+    INTERCEPT_FUNCTION(void, __atomic_load, size_t, void*, void*, int);
+    REAL(__atomic_load)(size, ptr, ret, order);
+}
+
+ATOMIC_INTERCEPTOR(void, __atomic_store, size_t size, void* ptr, void* val, int order)
+{
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_store", size, ptr);
+
+    INTERCEPT_FUNCTION(void, __atomic_store, size_t, void*, void*, int);
+    REAL(__atomic_store)(size, ptr, val, order);
+}
+
+ATOMIC_INTERCEPTOR(void, __atomic_exchange, size_t size, void* ptr, void* val, void* ret, int order)
+{
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_exchange", size, ptr);
+
+    INTERCEPT_FUNCTION(void, __atomic_exchange, size_t, void*, void*, void*, int);
+    REAL(__atomic_exchange)(size, ptr, val, ret, order);
+}
+
+ATOMIC_INTERCEPTOR(bool, __atomic_compare_exchange, size_t size, void* ptr, void* expected, void* desired,
+                   int success_order, int failure_order)
+{
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_compare_exchange", size, ptr);
+
+    INTERCEPT_FUNCTION(bool, __atomic_compare_exchange, size_t, void*, void*, void*, int, int);
+    return REAL(__atomic_compare_exchange)(size, ptr, expected, desired, success_order, failure_order);
+}
+
+#if defined (__SIZEOF_INT128__)
+// 16 byte atomics can be lock-free depending on the CPU so these are only
+// reported if libatomic falls back to a lock
+using atomic_uint128 = unsigned __int128;
+
+ATOMIC_INTERCEPTOR(atomic_uint128, __atomic_load_16, const volatile void* ptr, int order)
+{
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_load_16", 16, const_cast<const void*> (ptr));
+
+    INTERCEPT_FUNCTION(atomic_uint128, __atomic_load_16, const volatile void*, int);
+    return REAL(__atomic_load_16)(ptr, order);
+}
 
-INTERCEPTOR(int, futex, int *uaddr, int op, int val, const struct timespec *timeout, int *uaddr2, int val3)
+ATOMIC_INTERCEPTOR(void, __atomic_store_16, volatile void* ptr, atomic_uint128 val, int order)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::futex, __func__);
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_store_16", 16, const_cast<const void*> (ptr));
 
-    INTERCEPT_FUNCTION(int, futex, int*, int, int, const struct timespec*, int*, int);
-    return REAL(futex)(uaddr, op, val, timeout, uaddr2, val3);
+    INTERCEPT_FUNCTION(void, __atomic_store_16, volatile void*, atomic_uint128, int);
+    REAL(__atomic_store_16)(ptr, val, order);
+}
+
+ATOMIC_INTERCEPTOR(atomic_uint128, __atomic_exchange_16, volatile void* ptr, atomic_uint128 val, int order)
+{
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_exchange_16", 16, const_cast<const void*> (ptr));
+
+    INTERCEPT_FUNCTION(atomic_uint128, __atomic_exchange_16, volatile void*, atomic_uint128, int);
+    return REAL(__atomic_exchange_16)(ptr, val, order);
+}
+
+ATOMIC_INTERCEPTOR(bool, __atomic_compare_exchange_16, volatile void* ptr, void* expected, atomic_uint128 desired,
+                   int success_order, int failure_order)
+{
+    const auto cost_scope = log_atomic_if_realtime_context_and_enabled ("__atomic_compare_exchange_16", 16, const_cast<const void*> (ptr));
+
+    INTERCEPT_FUNCTION(bool, __atomic_compare_exchange_16, volatile void*, void*, atomic_uint128, int, int);
+    return REAL(__atomic_compare_exchange_16)(ptr, expected, desired, success_order, failure_order);
 }
 #endif
+#endif
+
 
 //==============================================================================
 // sleep
 //==============================================================================
 INTERCEPTOR(unsigned int, sleep, unsigned int seconds)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::sleep, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::sleep, __func__);
 
-    static auto real = (unsigned int (*)(unsigned int))dlsym(RTLD_NEXT, "sleep");
+    INTERCEPT_FUNCTION(unsigned int, sleep, unsigned int);
     return REAL(sleep)(seconds);
 }
 
 INTERCEPTOR(int, usleep, useconds_t useconds)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::usleep, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::usleep, __func__);
 
     INTERCEPT_FUNCTION(int, usleep, useconds_t);
     return REAL(usleep)(useconds);
@@ -532,18 +1503,106 @@ INTERCEPTOR(int, usleep, useconds_t useconds)
 
 INTERCEPTOR(int, nanosleep, const struct timespec *req, struct timespec * rem)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::nanosleep, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::nanosleep, __func__);
 
     INTERCEPT_FUNCTION(int, nanosleep, const struct timespec *, struct timespec *);
     return REAL(nanosleep)(req, rem);
 }
 
+#ifndef __APPLE__
+INTERCEPTOR(int, clock_nanosleep, clockid_t clock_id, int flags, const struct timespec *req, struct timespec *rem)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::clock_nanosleep, __func__);
+
+    INTERCEPT_FUNCTION(int, clock_nanosleep, clockid_t, int, const struct timespec *, struct timespec *);
+    return REAL(clock_nanosleep)(clock_id, flags, req, rem);
+}
+#endif
+
+//==============================================================================
+// waiting
+//==============================================================================
+INTERCEPTOR(int, sched_yield)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::sched_yield, __func__);
+
+    INTERCEPT_FUNCTION(int, sched_yield);
+    return REAL(sched_yield)();
+}
+
+INTERCEPTOR(int, poll, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    const auto cost_scope = log_wait_if_realtime_context_and_enabled (rtc::check_id::poll, __func__, timeout == 0);
+
+    INTERCEPT_FUNCTION(int, poll, struct pollfd *, nfds_t, int);
+    return REAL(poll)(fds, nfds, timeout);
+}
+
+INTERCEPTOR(int, select, int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
+{
+    const auto cost_scope = log_wait_if_realtime_context_and_enabled (rtc::check_id::select, __func__, is_zero (timeout));
+
+    INTERCEPT_FUNCTION(int, select, int, fd_set *, fd_set *, fd_set *, struct timeval *);
+    return REAL(select)(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+INTERCEPTOR(int, pselect, int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+            const struct timespec *timeout, const sigset_t *sigmask)
+{
+    const auto cost_scope = log_wait_if_realtime_context_and_enabled (rtc::check_id::pselect, __func__, is_zero (timeout));
+
+    INTERCEPT_FUNCTION(int, pselect, int, fd_set *, fd_set *, fd_set *, const struct timespec *, const sigset_t *);
+    return REAL(pselect)(nfds, readfds, writefds, exceptfds, timeout, sigmask);
+}
+
+INTERCEPTOR(int, sem_wait, sem_t *sem)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::sem_wait, __func__);
+
+    INTERCEPT_FUNCTION(int, sem_wait, sem_t *);
+    return REAL(sem_wait)(sem);
+}
+
+#ifndef __APPLE__
+INTERCEPTOR(int, ppoll, struct pollfd *fds, nfds_t nfds, const struct timespec *timeout, const sigset_t *sigmask)
+{
+    const auto cost_scope = log_wait_if_realtime_context_and_enabled (rtc::check_id::ppoll, __func__, is_zero (timeout));
+
+    INTERCEPT_FUNCTION(int, ppoll, struct pollfd *, nfds_t, const struct timespec *, const sigset_t *);
+    return REAL(ppoll)(fds, nfds, timeout, sigmask);
+}
+
+INTERCEPTOR(int, epoll_wait, int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    const auto cost_scope = log_wait_if_realtime_context_and_enabled (rtc::check_id::epoll_wait, __func__, timeout == 0);
+
+    INTERCEPT_FUNCTION(int, epoll_wait, int, struct epoll_event *, int, int);
+    return REAL(epoll_wait)(epfd, events, maxevents, timeout);
+}
+
+INTERCEPTOR(int, sem_timedwait, sem_t *sem, const struct timespec *abs_timeout)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::sem_timedwait, __func__);
+
+    INTERCEPT_FUNCTION(int, sem_timedwait, sem_t *, const struct timespec *);
+    return REAL(sem_timedwait)(sem, abs_timeout);
+}
+
+INTERCEPTOR(int, pthread_barrier_wait, pthread_barrier_t *barrier)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::pthread_barrier_wait, __func__);
+
+    INTERCEPT_FUNCTION(int, pthread_barrier_wait, pthread_barrier_t *);
+    return REAL(pthread_barrier_wait)(barrier);
+}
+#endif
+
 //==============================================================================
 // files
 //==============================================================================
 INTERCEPTOR(int, stat, const char* pathname, struct stat* statbuf)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::stat, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::stat, __func__);
 
     INTERCEPT_FUNCTION(int, stat, const char*, struct stat*);
     return REAL(stat)(pathname, statbuf);
@@ -551,7 +1610,7 @@ INTERCEPTOR(int, stat, const char* pathname, struct stat* statbuf)
 
 INTERCEPTOR(int, fstat, int fd, struct stat *statbuf)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::fstat, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::fstat, __func__);
 
     INTERCEPT_FUNCTION(int, fstat, int, struct stat*);
     return REAL(fstat)(fd, statbuf);
@@ -559,7 +1618,7 @@ INTERCEPTOR(int, fstat, int fd, struct stat *statbuf)
 
 INTERCEPTOR(int, open, const char *path, int oflag, ...)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::open, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::open, __func__);
 
     INTERCEPT_FUNCTION(int, open, const char*, int, ...);
 
@@ -573,7 +1632,7 @@ INTERCEPTOR(int, open, const char *path, int oflag, ...)
 
 INTERCEPTOR(FILE*, fopen, const char *path, const char *mode)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::fopen, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::fopen, __func__);
 
     INTERCEPT_FUNCTION(FILE*, fopen, const char*, const char*);
     auto result = REAL(fopen)(path, mode);
@@ -583,7 +1642,7 @@ INTERCEPTOR(FILE*, fopen, const char *path, const char *mode)
 
 INTERCEPTOR(int, openat, int fd, const char *path, int oflag, ...)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::openat, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::openat, __func__);
 
     INTERCEPT_FUNCTION(int, openat, int, const char*, int, ...);
 
@@ -597,7 +1656,7 @@ INTERCEPTOR(int, openat, int fd, const char *path, int oflag, ...)
 
 INTERCEPTOR(int, fcntl, int filedes, int cmd, ...)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::fcntl, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::fcntl, __func__);
 
     INTERCEPT_FUNCTION(int, fcntl, int, int, ...);
 
@@ -626,7 +1685,7 @@ INTERCEPTOR(int, fcntl, int filedes, int cmd, ...)
 #ifndef __APPLE__
 INTERCEPTOR(long, schedule, void)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::schedule, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::schedule, __func__);
 
     INTERCEPT_FUNCTION(long, schedule, void);
     return REAL(schedule)();
@@ -634,7 +1693,7 @@ INTERCEPTOR(long, schedule, void)
 
 INTERCEPTOR(long, context_switch, struct task_struct *prev, struct task_struct *next)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::context_switch, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::context_switch, __func__);
 
     INTERCEPT_FUNCTION(long, context_switch, struct task_struct *, struct task_struct *);
     return REAL(context_switch)(prev, next);
@@ -645,25 +1704,242 @@ INTERCEPTOR(long, context_switch, struct task_struct *prev, struct task_struct *
 // syscall is deprecated, but still in use in libc++
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
 
-#define FORWARD_ARGS(func, ...) func(__VA_ARGS__)
-#define EXPAND_ARGS(...) (__VA_ARGS__)
+#if __linux__
+/** The name and whether a futex operation can put the thread to sleep. */
+struct futex_operation
+{
+    const char* name;
+    bool can_block;
+};
 
-INTERCEPTOR(long int, syscall, long int sid, ...)
+constexpr futex_operation get_futex_operation (long op)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::syscall, __func__);
+    switch (op & FUTEX_CMD_MASK)
+    {
+        case FUTEX_WAIT:                return { "futex (FUTEX_WAIT)", true };
+        case FUTEX_WAIT_BITSET:         return { "futex (FUTEX_WAIT_BITSET)", true };
+        case FUTEX_WAIT_REQUEUE_PI:     return { "futex (FUTEX_WAIT_REQUEUE_PI)", true };
+        case FUTEX_LOCK_PI:             return { "futex (FUTEX_LOCK_PI)", true };
+       #ifdef FUTEX_LOCK_PI2
+        case FUTEX_LOCK_PI2:            return { "futex (FUTEX_LOCK_PI2)", true };
+       #endif
+        case FUTEX_WAKE:                return { "futex (FUTEX_WAKE)", false };
+        case FUTEX_WAKE_BITSET:         return { "futex (FUTEX_WAKE_BITSET)", false };
+        case FUTEX_WAKE_OP:             return { "futex (FUTEX_WAKE_OP)", false };
+        case FUTEX_REQUEUE:             return { "futex (FUTEX_REQUEUE)", false };
+        case FUTEX_CMP_REQUEUE:         return { "futex (FUTEX_CMP_REQUEUE)", false };
+        case FUTEX_CMP_REQUEUE_PI:      return { "futex (FUTEX_CMP_REQUEUE_PI)", false };
+        case FUTEX_TRYLOCK_PI:          return { "futex (FUTEX_TRYLOCK_PI)", false };
+        case FUTEX_UNLOCK_PI:           return { "futex (FUTEX_UNLOCK_PI)", false };
+        default:                        return { "futex", true };
+    }
+}
 
-    INTERCEPT_FUNCTION(long, syscall, long, ...);
+constexpr bool is_futex_syscall (long sid)
+{
+   #ifdef SYS_futex_time64
+    if (sid == SYS_futex_time64)
+        return true;
+   #endif
+
+    return sid == SYS_futex;
+}
+#endif
+
+/** Reports futex calls as check_id::futex if they can wait, or check_id::futex_wake if they only wake
+    other threads, and any other system call as check_id::syscall.
+    Disabling futex also disables futex_wake, the same as with nonblocking_wait.
+    arg1 is the second argument of the call, which is the operation for a futex.
+*/
+[[nodiscard, gnu::always_inline]] inline rtc::violation_cost_scope log_syscall_if_realtime_context_and_enabled (long sid, long arg1)
+{
+   #if __linux__
+   #ifdef SYS_futex_waitv
+    if (sid == SYS_futex_waitv)
+        return log_function_if_realtime_context_and_enabled (rtc::check_id::futex, "futex_waitv");
+   #endif
+
+    if (is_futex_syscall (sid))
+    {
+        const auto operation = get_futex_operation (arg1);
+
+        if (operation.can_block)
+            return log_function_if_realtime_context_and_enabled (rtc::check_id::futex, operation.name);
+
+        if (! rtc::has_initialised || ! rtc::is_check_enabled_for_thread (rtc::check_id::futex))
+            return {};
+
+        return log_function_if_realtime_context_and_enabled (rtc::check_id::futex_wake, operation.name);
+    }
+   #else
+    (void) arg1;
+   #endif
+
+    return log_function_if_realtime_context_and_enabled (rtc::check_id::syscall, "syscall");
+}
 
+INTERCEPTOR(long int, syscall, long int sid, ...)
+{
+    // The number of arguments depends on the call so, like the sanitizers, the
+    // maximum of six are read and forwarded. Any extra are ignored by the kernel.
     va_list args;
     va_start(args, sid);
+
+    long arg[6];
+
+    for (auto& a : arg)
+        a = va_arg(args, long);
+
     va_end(args);
 
-    return REAL(syscall)(sid);
+    const auto cost_scope = log_syscall_if_realtime_context_and_enabled (sid, arg[1]);
+
+    INTERCEPT_FUNCTION(long, syscall, long, ...);
+    return REAL(syscall)(sid, arg[0], arg[1], arg[2], arg[3], arg[4], arg[5]);
 }
 
 #pragma clang diagnostic pop
 
 
+//==============================================================================
+// dynamic loading
+//==============================================================================
+#if __linux__
+namespace rtc
+{
+using dlsym_function = void* (*) (void*, const char*);
+
+/** Returns libc's dlsym, skipping the interceptor below.
+    The oldest version for the architecture is tried first as this always exists
+    and a failed lookup would allocate the error message.
+*/
+dlsym_function get_real_dlsym()
+{
+    static auto real = []
+    {
+        for (auto version : {
+                            #if defined (__x86_64__)
+                             "GLIBC_2.2.5",
+                            #elif defined (__aarch64__)
+                             "GLIBC_2.17",
+                            #elif defined (__i386__)
+                             "GLIBC_2.0",
+                            #endif
+                             "GLIBC_2.34" })
+        {
+            if (auto function = dlvsym (RTLD_NEXT, "dlsym", version))
+                return reinterpret_cast<dlsym_function> (function);
+        }
+
+        return static_cast<dlsym_function> (nullptr);
+    }();
+
+    return real;
+}
+
+void* get_real_function (const char* name)
+{
+    // RTLD_NEXT is resolved relative to the caller of dlsym which is rtcheck here
+    return get_real_dlsym() (RTLD_NEXT, name);
+}
+
+/** Emulates dlsym (RTLD_NEXT, symbol) for a caller outside of rtcheck.
+    Forwarding RTLD_NEXT to libc would search after rtcheck rather than after the
+    caller so instead this walks the objects loaded after the caller and returns
+    the first definition that's in one of them.
+*/
+void* dlsym_next_after (const void* caller, const char* symbol)
+{
+    static auto real_dlopen = reinterpret_cast<void* (*) (const char*, int)> (get_real_function ("dlopen"));
+    static auto real_dlclose = reinterpret_cast<int (*) (void*)> (get_real_function ("dlclose"));
+
+    Dl_info info {};
+    link_map* caller_map = nullptr;
+
+    if (dladdr1 (caller, &info, reinterpret_cast<void**> (&caller_map), RTLD_DL_LINKMAP) == 0 || caller_map == nullptr)
+        return nullptr;
+
+    for (auto map = caller_map->l_next; map != nullptr; map = map->l_next)
+    {
+        // This just takes a reference to an object that's already loaded
+        auto handle = real_dlopen (map->l_name[0] != 0 ? map->l_name : nullptr, RTLD_LAZY | RTLD_NOLOAD);
+
+        if (handle == nullptr)
+            continue;
+
+        // Looking up from a handle also searches its dependencies so check the
+        // definition is actually in this object
+        auto address = get_real_dlsym() (handle, symbol);
+        link_map* symbol_map = nullptr;
+        const bool is_defined_in_map = address != nullptr
+                                        && dladdr1 (address, &info, reinterpret_cast<void**> (&symbol_map), RTLD_DL_LINKMAP) != 0
+                                        && symbol_map == map;
+        real_dlclose (handle);
+
+        if (is_defined_in_map)
+            return address;
+    }
+
+    // Clear any errors from the objects that couldn't be opened
+    dlerror();
+    return nullptr;
+}
+}
+#endif
+
+INTERCEPTOR(void*, dlopen, const char* filename, int flags)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::dlopen, __func__);
+
+    INTERCEPT_FUNCTION(void*, dlopen, const char*, int);
+    const auto result = REAL(dlopen)(filename, flags);
+    rtc::update_trusted_modules();
+
+    return result;
+}
+
+INTERCEPTOR(int, dlclose, void* handle)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::dlclose, __func__);
+
+    INTERCEPT_FUNCTION(int, dlclose, void*);
+    const auto result = REAL(dlclose)(handle);
+    rtc::update_trusted_modules();
+
+    return result;
+}
+
+#if __linux__
+INTERCEPTOR(void*, dlmopen, Lmid_t lmid, const char* filename, int flags)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::dlmopen, __func__);
+
+    INTERCEPT_FUNCTION(void*, dlmopen, Lmid_t, const char*, int);
+    const auto result = REAL(dlmopen)(lmid, filename, flags);
+    rtc::update_trusted_modules();
+
+    return result;
+}
+
+INTERCEPTOR(void*, dlsym, void* handle, const char* symbol)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::dlsym, __func__);
+
+    if (handle == RTLD_NEXT)
+        return rtc::dlsym_next_after (__builtin_return_address (0), symbol);
+
+    return rtc::get_real_dlsym() (handle, symbol);
+}
+
+INTERCEPTOR(int, dl_iterate_phdr, int (*callback) (dl_phdr_info*, size_t, void*), void* data)
+{
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::dl_iterate_phdr, __func__);
+
+    INTERCEPT_FUNCTION(int, dl_iterate_phdr, int (*) (dl_phdr_info*, size_t, void*), void*);
+    return REAL(dl_iterate_phdr)(callback, data);
+}
+#endif
+
 //==============================================================================
 // Apple
 //==============================================================================
@@ -675,13 +1951,13 @@ INTERCEPTOR(long int, syscall, long int sid, ...)
 
 INTERCEPTOR(void, OSSpinLockLock, volatile OSSpinLock *lock)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::OSSpinLockLock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::OSSpinLockLock, __func__);
     return REAL(OSSpinLockLock)(lock);
 }
 
 INTERCEPTOR(void, os_unfair_lock_lock, os_unfair_lock_t lock)
 {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::os_unfair_lock_lock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::os_unfair_lock_lock, __func__);
     return REAL(os_unfair_lock_lock)(lock);
 }
 
@@ -699,7 +1975,7 @@ extern "C" {
 }
 
 INTERCEPTOR(void, _os_nospin_lock_lock, _os_nospin_lock_t lock) {
-    log_function_if_realtime_context_and_enabled (rtc::check_flags::os_unfair_lock_lock, __func__);
+    const auto cost_scope = log_function_if_realtime_context_and_enabled (rtc::check_id::os_unfair_lock_lock, __func__);
     return REAL(_os_nospin_lock_lock)(lock);
 }
 
@@ -711,5 +1987,14 @@ INTERCEPTOR(void, _os_nospin_lock_lock, _os_nospin_lock_t lock) {
 __attribute__((constructor))
 void init()
 {
+    // The first call to backtrace can load libgcc and allocate so do it up front
+    void* frame;
+    backtrace (&frame, 1);
+
+    rtc::open_violation_log_from_environment();
+    rtc::load_suppressions_from_environment();
+    rtc::load_trusted_modules_from_environment();
+    rtc::load_overhead_options_from_environment();
+    rtc::load_check_policies_from_environment();
     rtc::has_initialised = true;
 }
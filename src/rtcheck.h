@@ -1,6 +1,17 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <csignal>
 #include <cstdint>
+#include <iosfwd>
+#include <source_location>
+#include <vector>
+#include <unistd.h>
+
+#include "rtcheck_checks.h"
 
 namespace rtc
 {
@@ -9,14 +20,22 @@ namespace rtc
     /** Puts the current thread in to a real-time context.
         You'd generally put one of these at the start of your real-time thread which
         will enable checking of real-time safety violations.
+        These can be nested, e.g. one per node of a processing graph, and the thread
+        stays in a real-time context until the outermost one exits. Violations are
+        attributed to the label of the innermost labelled scope.
      */
     struct realtime_context
     {
-        /** Enters the real-time context. */
-        realtime_context();
+        /** Enters the real-time context.
+            The label must outlive the scope, e.g. a string literal.
+        */
+        explicit realtime_context (const char* label = nullptr);
 
         /** Exits the real-time context. */
         ~realtime_context();
+
+        realtime_context (const realtime_context&) = delete;
+        realtime_context& operator= (const realtime_context&) = delete;
     };
 
     //==============================================================================
@@ -34,6 +53,94 @@ namespace rtc
 
         /** Re-enters the real-time context. */
         ~non_realtime_context();
+
+    private:
+        int previous_base = 0;
+        bool was_realtime_flag_set = false;
+    };
+
+    //==============================================================================
+    /** Marks a task, rather than a thread, as real-time.
+        A scheduler can attach one of these to a job and activate it around the job's
+        execution on whichever worker thread runs it. Whilst active, the worker is
+        in a real-time context and any violations are attributed to the token's
+        label and the place it was created.
+        Activating and deactivating only makes a few stores so, unlike
+        realtime_context, this doesn't run the watchdog, profiler or preparation
+        checks. A token can only be active on one thread at a time and mustn't be
+        moved or destroyed whilst active.
+     */
+    struct realtime_token
+    {
+        /** Creates a token. The label must outlive it, e.g. a string literal. */
+        explicit realtime_token (const char* label = nullptr,
+                                 std::source_location origin = std::source_location::current());
+
+        realtime_token (realtime_token&&) noexcept;
+        realtime_token& operator= (realtime_token&&) noexcept;
+
+        realtime_token (const realtime_token&) = delete;
+        realtime_token& operator= (const realtime_token&) = delete;
+
+        /** Puts the calling thread in to a real-time context on behalf of this token. */
+        void activate();
+
+        /** Restores the calling thread to the context it was in before activate. */
+        void deactivate();
+
+        const char* label = nullptr;    /// A description of the task
+        std::source_location origin;    /// Where the token was created
+
+    private:
+        const realtime_token* previous_token = nullptr;
+    };
+
+    /** Activates a realtime_token for the life-time of the object. */
+    struct realtime_token_scope
+    {
+        explicit realtime_token_scope (realtime_token& t) : token (t)   { token.activate(); }
+        ~realtime_token_scope()                                         { token.deactivate(); }
+
+        realtime_token_scope (const realtime_token_scope&) = delete;
+        realtime_token_scope& operator= (const realtime_token_scope&) = delete;
+
+    private:
+        realtime_token& token;
+    };
+
+    //==============================================================================
+    /** A pool of threads that are real-time together for the duration of a cycle.
+        Worker threads join once and the thread driving the cycle calls begin_cycle
+        and end_cycle around each one. Between cycles the workers are free to
+        allocate etc. During a cycle they're in a real-time context without having
+        to enter one themselves, and the interceptors only make one extra relaxed
+        load to check this. A thread can belong to one group at a time and must
+        leave it before the group is destroyed.
+     */
+    struct realtime_group
+    {
+        realtime_group() = default;
+
+        realtime_group (const realtime_group&) = delete;
+        realtime_group& operator= (const realtime_group&) = delete;
+
+        /** Adds the calling thread to the group. */
+        void join();
+
+        /** Removes the calling thread from its group. */
+        void leave();
+
+        /** Puts all the threads in the group in to a real-time context. */
+        void begin_cycle()          { in_cycle.store (true, std::memory_order_release); }
+
+        /** Takes all the threads in the group out of the real-time context. */
+        void end_cycle()            { in_cycle.store (false, std::memory_order_release); }
+
+        /** Returns true between begin_cycle and end_cycle. */
+        bool is_in_cycle() const    { return in_cycle.load (std::memory_order_relaxed); }
+
+    private:
+        alignas (64) std::atomic<bool> in_cycle { false };
     };
 
     //==============================================================================
@@ -52,8 +159,10 @@ namespace rtc
     /** Holds the various supported error modes. */
     enum class error_mode
     {
-        exit,   /// Exit with value 1, default
-        cont    /// Continue execution
+        exit,       /// Exit with value 1, default
+        cont,       /// Continue execution
+        callback,   /// Call the violation_handler and continue execution
+        trap        /// Raise SIGTRAP at the violation site without formatting a report
     };
 
     /** Sets the global error more to determine the behaviour when a real-time
@@ -64,96 +173,694 @@ namespace rtc
     /** Returns the global error detection mode. */
     error_mode get_error_mode();
 
+    /** Sets the error mode for the calling thread, overriding the global one. */
+    void set_error_mode_for_thread (error_mode);
+
+    /** Removes any error mode set for the calling thread so the global one is used. */
+    void reset_error_mode_for_thread();
+
+    /** Returns the error mode in use for the calling thread. */
+    error_mode get_error_mode_for_thread();
+
 
     //==============================================================================
     //==============================================================================
-    /** Enum specifying the different checks which can be used to individually or as
-       a group be disabled for the current thread.
+    /** The index of each individual check, generated from RTCHECK_CHECKS in rtcheck_checks.h. */
+    enum class check_id : uint16_t
+    {
+       #define RTCHECK_CHECK_ID(name, group, platform) name,
+        RTCHECK_CHECKS (RTCHECK_CHECK_ID)
+       #undef RTCHECK_CHECK_ID
+    };
+
+    /** The groups that checks can belong to. */
+    enum class check_group : uint8_t
+    {
+        none,
+       #define RTCHECK_CHECK_GROUP(name) name,
+        RTCHECK_CHECK_GROUPS (RTCHECK_CHECK_GROUP)
+       #undef RTCHECK_CHECK_GROUP
+    };
+
+    /** The platforms a check is available on. */
+    enum class check_platform : uint8_t
+    {
+        any,
+        linux_only,
+        apple_only
+    };
+
+    /** The number of individual checks. */
+    constexpr std::size_t num_checks = 0
+       #define RTCHECK_COUNT_CHECK(name, group, platform) + 1
+        RTCHECK_CHECKS (RTCHECK_COUNT_CHECK)
+       #undef RTCHECK_COUNT_CHECK
+        ;
+
+    /** The maximum number of checks a check_flags can hold. */
+    constexpr std::size_t max_checks = 128;
+
+    static_assert (num_checks <= max_checks, "max_checks needs increasing to hold all the checks");
+
+    /** Describes an individual check. */
+    struct check_info
+    {
+        const char* name;
+        check_group group;
+        check_platform platform;
+    };
+
+    /** The description of every check, indexed by check_id. */
+    inline constexpr check_info check_infos[] =
+    {
+       #define RTCHECK_CHECK_INFO(name, group, platform) { #name, check_group::group, check_platform::platform },
+        RTCHECK_CHECKS (RTCHECK_CHECK_INFO)
+       #undef RTCHECK_CHECK_INFO
+    };
+
+    //==============================================================================
+    /** A fixed size set of checks which can be used to individually or as a group
+        disable checks for the current thread.
+        Each check and group is available as a static member, e.g. check_flags::malloc
+        or check_flags::memory, and these can be combined with |. Testing a single
+        check is one load of the word holding it and a mask.
      */
-    enum class check_flags : uint64_t
-    {
-        //==============================================================================
-        // memory
-        //==============================================================================
-        malloc                          = 1 << 0,
-        calloc                          = 1 << 1,
-        realloc                         = 1 << 2,
-        reallocf                        = 1 << 3, // apple only
-        valloc                          = 1 << 4,
-        free                            = 1 << 5,
-        posix_memalign                  = 1 << 6,
-        mmap                            = 1 << 7,
-        munmap                          = 1 << 8,
-
-        memory                          = malloc | calloc | realloc | reallocf | valloc
-                                            | free | posix_memalign | mmap | munmap,
-
-        //==============================================================================
-        // threads
-        //==============================================================================
-        pthread_create                  = 1 << 9,
-        pthread_mutex_lock              = 1 << 10,
-        pthread_mutex_unlock            = 1 << 11,
-        pthread_join                    = 1 << 12,
-        pthread_cond_signal             = 1 << 13,
-        pthread_cond_broadcast          = 1 << 14,
-        pthread_cond_wait               = 1 << 15,
-        pthread_rwlock_init             = 1 << 16,
-        pthread_rwlock_destroy          = 1 << 17,
-        pthread_cond_timedwait          = 1 << 18,
-        pthread_rwlock_rdlock           = 1 << 19,
-        pthread_rwlock_unlock           = 1 << 20,
-        pthread_rwlock_wrlock           = 1 << 21,
-        pthread_spin_lock               = 1 << 22,      // linux only
-        futex                           = 1 << 23,      // linux only
-        OSSpinLockLock                  = 1 << 24,      // apple only
-        os_unfair_lock_lock             = 1 << 25,      // apple only
-        _os_nospin_lock_lock            = 1 << 26,      // apple only
-
-        threads = pthread_create | pthread_mutex_lock | pthread_mutex_unlock | pthread_join
-                    | pthread_cond_signal | pthread_cond_broadcast | pthread_cond_wait
-                    | pthread_rwlock_init | pthread_rwlock_destroy | pthread_cond_timedwait
-                    | pthread_rwlock_rdlock | pthread_rwlock_unlock | pthread_rwlock_wrlock
-                    | pthread_spin_lock | futex | OSSpinLockLock | os_unfair_lock_lock
-                    | _os_nospin_lock_lock,
-
-        //==============================================================================
-        // sleeping
-        //==============================================================================
-        sleep                           = 1 << 27,
-        usleep                          = 1 << 28,
-        nanosleep                       = 1 << 29,
-
-        sleeping                        = sleep | usleep | nanosleep,
-
-        //==============================================================================
-        // files
-        //==============================================================================
-        stat                            = 1 << 30,
-        fstat                           = 1ull << 31,
-        open                            = 1ull << 32,
-        fopen                           = 1ull << 33,
-        openat                          = 1ull << 34,
-        fcntl                           = 1ull << 35,
-
-        files                           = stat | fstat | open | fopen | openat,
-
-        //==============================================================================
-        // system
-        //==============================================================================
-        schedule                        = 1ull << 36,  // linux only
-        context_switch                  = 1ull << 37,  // linux only
-        syscall                         = 1ull << 38,
-
-        sys                             = schedule | context_switch | syscall
-    };
-
-    /** Disables a number of checks for the current thread. */
+    struct check_flags
+    {
+        static constexpr std::size_t num_words = max_checks / 64;
+
+        /** Creates an empty set. */
+        constexpr check_flags() = default;
+
+        /** Creates a set containing a single check. */
+        constexpr check_flags (check_id id)
+        {
+            set (static_cast<std::size_t> (id));
+        }
+
+        /** Creates a set of the checks in a group. */
+        static constexpr check_flags from_group (check_group group)
+        {
+            check_flags flags;
+
+            for (std::size_t i = 0; i < num_checks; ++i)
+                if (check_infos[i].group == group)
+                    flags.set (i);
+
+            return flags;
+        }
+
+        /** Creates a set from a mask of the first 64 checks, for the older uint64_t functions. */
+        static constexpr check_flags from_bits (uint64_t bits)
+        {
+            check_flags flags;
+            flags.words[0] = bits;
+            return flags;
+        }
+
+        /** Returns a set of all the checks. */
+        static constexpr check_flags all()
+        {
+            return ~check_flags();
+        }
+
+        /** Returns the set as a mask, for the older uint64_t functions.
+            Only the first 64 checks fit in a mask so the set mustn't contain any others.
+        */
+        constexpr explicit operator uint64_t() const
+        {
+            for (std::size_t i = 1; i < num_words; ++i)
+                assert (words[i] == 0 && "check_flags with checks past the first 64 can't be converted to a mask");
+
+            return words[0];
+        }
+
+        constexpr bool test (std::size_t index) const           { return ((words[index / 64] >> (index % 64)) & 1) != 0; }
+        constexpr void set (std::size_t index)                  { words[index / 64] |= uint64_t (1) << (index % 64); }
+
+        constexpr bool any() const
+        {
+            for (auto w : words)
+                if (w != 0)
+                    return true;
+
+            return false;
+        }
+
+        constexpr bool none() const                             { return ! any(); }
+
+        /** Returns true if any check is in both sets. */
+        constexpr bool intersects (const check_flags& other) const
+        {
+            return (*this & other).any();
+        }
+
+        constexpr check_flags operator| (const check_flags& other) const
+        {
+            auto result = *this;
+
+            for (std::size_t i = 0; i < num_words; ++i)
+                result.words[i] |= other.words[i];
+
+            return result;
+        }
+
+        constexpr check_flags operator& (const check_flags& other) const
+        {
+            auto result = *this;
+
+            for (std::size_t i = 0; i < num_words; ++i)
+                result.words[i] &= other.words[i];
+
+            return result;
+        }
+
+        /** Returns the checks not in this set. */
+        constexpr check_flags operator~() const
+        {
+            check_flags result;
+
+            for (std::size_t i = 0; i < num_checks; ++i)
+                if (! test (i))
+                    result.set (i);
+
+            return result;
+        }
+
+        constexpr check_flags& operator|= (const check_flags& other)   { return *this = *this | other; }
+        constexpr check_flags& operator&= (const check_flags& other)   { return *this = *this & other; }
+
+        constexpr bool operator== (const check_flags&) const = default;
+
+       #define RTCHECK_DECLARE_CHECK(name, group, platform) static const check_flags name;
+        RTCHECK_CHECKS (RTCHECK_DECLARE_CHECK)
+       #undef RTCHECK_DECLARE_CHECK
+
+       #define RTCHECK_DECLARE_GROUP(name) static const check_flags name;
+        RTCHECK_CHECK_GROUPS (RTCHECK_DECLARE_GROUP)
+       #undef RTCHECK_DECLARE_GROUP
+
+        std::array<uint64_t, num_words> words {};
+    };
+
+   #define RTCHECK_DEFINE_CHECK(name, group, platform) inline constexpr check_flags check_flags::name { check_id::name };
+    RTCHECK_CHECKS (RTCHECK_DEFINE_CHECK)
+   #undef RTCHECK_DEFINE_CHECK
+
+   #define RTCHECK_DEFINE_GROUP(name) inline constexpr check_flags check_flags::name = check_flags::from_group (check_group::name);
+    RTCHECK_CHECK_GROUPS (RTCHECK_DEFINE_GROUP)
+   #undef RTCHECK_DEFINE_GROUP
+
+    /** Returns the name of a check, as used in suppression files. */
+    constexpr const char* get_check_name (check_id id)
+    {
+        return check_infos[static_cast<std::size_t> (id)].name;
+    }
+
+    /** Disables a number of checks for the current thread.
+        The flags are a mask of the first 64 checks, use the check_flags overload for the rest.
+    */
     void disable_checks_for_thread (uint64_t flags);
 
     /** Disables a check for the current thread. */
     void disable_checks_for_thread (check_flags);
 
-    /** Returns true if the current check is enabled. */
+    /** Returns true if the current check is enabled.
+        Only a single check can be passed, not a group.
+    */
     [[nodiscard]] bool is_check_enabled_for_thread (check_flags);
+
+    //==============================================================================
+    /** What happens when a check is violated in a real-time context. */
+    enum class check_policy : uint8_t
+    {
+        default_mode,   /// Carry out the thread's error_mode, default
+        ignore,         /// Do nothing
+        count,          /// Only add to the violation stats, without capturing the stack
+        log_once,       /// Report the first violation from each call site and count the rest
+        log,            /// Report every violation and continue
+        exit,           /// Report and exit with value 1
+        trap            /// Raise SIGTRAP at the violation site
+    };
+
+    /** Sets the policy for a number of checks, for all threads.
+        The policies are held in a table indexed by check which is copied, updated
+        and published with a single atomic store, so this can be called at any time.
+        The logging policies use the violation_handler if the error mode is
+        error_mode::callback. As count doesn't capture the stack, suppressions
+        aren't applied to counted violations. This must not be called in a
+        real-time context.
+    */
+    void set_check_policy (check_flags, check_policy);
+
+    /** Returns the policy for a check. */
+    check_policy get_check_policy (check_id);
+
+    /** Sets every check back to check_policy::default_mode and forgets the call
+        sites reported by check_policy::log_once.
+    */
+    void reset_check_policies();
+
+    /** Loads policies from a file with a rule per line, each a '|' separated list of
+        check or group names, a colon and a policy name, e.g.
+        @code
+        # Fail CI on any mapping but only count mutex locks
+        mmap|munmap: exit
+        pthread_mutex_lock|pthread_mutex_unlock: count
+        @endcode
+        The policy names are default, ignore, count, log_once, log, exit and trap. Later
+        rules override earlier ones. Rules can also be set at startup with the
+        RTCHECK_POLICY environment variable, separated by commas, or loaded from the
+        file named by RTCHECK_POLICY_FILE.
+        Returns false if the file couldn't be read.
+    */
+    bool load_check_policies (const char* path);
+
+    /** Loads a file of suppressions for known violations in code that can't be changed.
+        Each line is a '|' separated list of check names, or "all", followed by a
+        colon and a pattern, e.g.
+        @code
+        # Suppresses violations with this function anywhere in the stack
+        malloc|free:audio::Processor::prepare
+        # Suppresses violations with any frame in a module whose path matches
+        all:module:libvendor.so
+        @endcode
+        Patterns match anywhere in the demangled function name or module path and
+        can contain * wildcards. The rules are matched against the symbols of the
+        loaded modules up front, and again when modules are loaded or unloaded, so
+        checking a violation is a lookup per frame. These can also be loaded from
+        the file named by the RTCHECK_SUPPRESSIONS environment variable.
+        This is only supported on Linux and returns false if the file can't be read.
+    */
+    bool load_suppressions (const char* path);
+
+    /** Trusts calls made from any module whose path contains the name, e.g. an
+        audited vendor library or a real-time safe allocator that only maps memory
+        whilst warming up. Intercepted functions called directly from trusted code
+        aren't reported. The module's address range is found now and again whenever
+        modules are loaded or unloaded. Modules can also be trusted with the
+        RTCHECK_TRUSTED_MODULES environment variable as a ':' separated list.
+    */
+    void trust_module (const char* name);
+
+    /** Trusts calls made from code between begin and end. */
+    void trust_address_range (const void* begin, const void* end);
+
+    /** Trusts calls made from the function containing an address.
+        Returns false if the function's symbol can't be found.
+    */
+    bool trust_function (const void* function);
+
+    //==============================================================================
+    //==============================================================================
+    /** Holds the number of violations detected for each individual check. */
+    struct violation_counts
+    {
+        /** Returns the number of violations for a check or group of checks. */
+        [[nodiscard]] uint64_t get (check_flags) const;
+
+        /** Returns the number of violations for all checks. */
+        [[nodiscard]] uint64_t total() const;
+
+        /** The counts indexed by check_id. */
+        std::array<uint64_t, num_checks> counts {};
+    };
+
+    /** The violations detected on a single thread. */
+    struct thread_violation_stats
+    {
+        uint64_t thread_id = 0;     /// The OS id of the thread
+        violation_counts counts;    /// Violations detected since the last reset
+    };
+
+    /** The violations that happened inside a labelled realtime_context. */
+    struct scope_violation_count
+    {
+        const char* label = nullptr;    /// The label of the innermost labelled scope
+        uint64_t count = 0;             /// Violations detected since the last reset
+    };
+
+    /** A snapshot of the violations detected since the last reset. */
+    struct violation_stats
+    {
+        /** The violations for all threads, including ones that have exited. */
+        violation_counts total;
+
+        /** The violations for each currently running thread that has had one. */
+        std::vector<thread_violation_stats> threads;
+
+        /** The violations attributed to each labelled realtime_context. */
+        std::vector<scope_violation_count> scopes;
+    };
+
+    /** Returns the violations detected since the last call to reset_violation_stats().
+        The counts are read with relaxed loads so this never synchronises with
+        real-time threads. Counts from violations happening concurrently with this
+        call may or may not be included.
+    */
+    [[nodiscard]] violation_stats get_violation_stats();
+
+    /** Returns the violations detected on the calling thread since the last reset. */
+    [[nodiscard]] violation_counts get_violation_stats_for_thread();
+
+    /** Resets the violation counts for all threads. */
+    void reset_violation_stats();
+
+    //==============================================================================
+    //==============================================================================
+    struct thread_slot;
+
+    /** Measures a single cycle of a periodic real-time callback such as an audio
+        callback. Create one at the start of each callback with the expected period,
+        e.g. the buffer size divided by the sample rate.
+        This records how late the cycle started compared to the one before it plus
+        the period (the wake-up jitter), the time spent in the scope as a fraction of
+        the period (the load) and the number of consecutive cycles that overran the
+        period. These are written to preallocated histograms for the calling thread
+        which can be read with get_cycle_stats().
+        This doesn't enter a real-time context itself so can be used either side of a
+        realtime_context.
+     */
+    struct cycle_scope
+    {
+        explicit cycle_scope (std::chrono::nanoseconds period);
+        ~cycle_scope();
+
+        cycle_scope (const cycle_scope&) = delete;
+        cycle_scope& operator= (const cycle_scope&) = delete;
+
+    private:
+        thread_slot* slot = nullptr;
+        int64_t start_ns = 0;
+        int64_t period_ns = 0;
+    };
+
+    /** The cycles measured on a single thread. */
+    struct cycle_stats
+    {
+        static constexpr std::size_t num_jitter_buckets = 24;
+        static constexpr std::size_t num_load_buckets = 41;
+        static constexpr std::size_t num_overrun_streak_buckets = 16;
+
+        uint64_t thread_id = 0;                 /// The OS id of the thread
+        std::chrono::nanoseconds period {};     /// The period of the most recent cycle
+        uint64_t num_cycles = 0;                /// Cycles measured since the last reset
+        uint64_t num_overruns = 0;              /// Cycles that took longer than the period
+        std::chrono::nanoseconds max_jitter {}; /// The latest a cycle has started
+        uint32_t current_overrun_streak = 0;    /// Overruns since the last cycle that didn't overrun
+        uint32_t longest_overrun_streak = 0;    /// The most consecutive overruns
+
+        /** Counts of the absolute wake-up jitter. Bucket 0 is less than 1us and
+            bucket i is [2^(i-1), 2^i) us, with the last bucket holding everything
+            above that.
+        */
+        std::array<uint64_t, num_jitter_buckets> jitter {};
+
+        /** Counts of the load in 5% steps, so bucket i is [5i%, 5(i+1)%) of the
+            period. The last bucket holds loads of 200% and above.
+        */
+        std::array<uint64_t, num_load_buckets> load {};
+
+        /** Counts of overrun streaks once they've ended. Bucket i is a streak of
+            i + 1 cycles with the last bucket holding all the longer ones.
+        */
+        std::array<uint64_t, num_overrun_streak_buckets> overrun_streaks {};
+    };
+
+    /** Returns the cycle stats for each currently running thread that has measured a
+        cycle since the last call to reset_cycle_stats().
+        Like get_violation_stats(), these are read with relaxed loads so never
+        synchronise with the real-time threads.
+    */
+    [[nodiscard]] std::vector<cycle_stats> get_cycle_stats();
+
+    /** Returns the cycle stats for the calling thread. */
+    [[nodiscard]] cycle_stats get_cycle_stats_for_thread();
+
+    /** Resets the cycle stats for all threads.
+        Each thread clears its histograms at the start of its next cycle.
+    */
+    void reset_cycle_stats();
+
+    //==============================================================================
+    //==============================================================================
+    /** The time spent in rtcheck itself by real-time code. */
+    struct overhead_counts
+    {
+        uint64_t num_hook_calls = 0;                    /// Interceptor and log_function_if_realtime_context calls
+        std::chrono::nanoseconds hook_time {};          /// Total time in the hooks, including stack capture and reporting
+        std::chrono::nanoseconds max_hook_time {};      /// The slowest single hook call
+        std::chrono::nanoseconds stack_capture_time {}; /// Time spent capturing the stacks of violations
+        std::chrono::nanoseconds reporting_time {};     /// Time spent logging and reporting violations
+        std::chrono::nanoseconds realtime_time {};      /// Total time spent in realtime_contexts
+
+        /** Returns the fraction of the time in realtime_contexts that was spent in rtcheck. */
+        [[nodiscard]] double get_realtime_share() const;
+    };
+
+    /** The overhead on a single thread. */
+    struct thread_overhead_stats
+    {
+        uint64_t thread_id = 0;     /// The OS id of the thread
+        overhead_counts counts;     /// The overhead since accounting was enabled
+    };
+
+    /** A snapshot of the overhead since accounting was enabled. */
+    struct overhead_stats
+    {
+        /** The overhead for all threads, including ones that have exited. */
+        overhead_counts total;
+
+        /** The overhead for each currently running thread that has been measured. */
+        std::vector<thread_overhead_stats> threads;
+    };
+
+    /** Starts timing rtcheck's own hooks so their cost can be told apart from the
+        cost of the code being checked.
+        Whilst enabled, the interceptors, log_function_if_realtime_context, stack
+        capture and reporting are timed with the CPU's cycle counter, along with the
+        time spent in each realtime_context, and accumulated per thread. Only calls
+        made inside a realtime_context entered after this is enabled are counted.
+        This can also be enabled by setting the RTCHECK_OVERHEAD environment variable
+        to 1, which also prints a summary to stderr when the process exits.
+    */
+    void enable_overhead_accounting();
+
+    /** Stops timing rtcheck's hooks. The counts so far are kept. */
+    void disable_overhead_accounting();
+
+    /** Returns the overhead measured so far.
+        The counts are read with relaxed loads so this never synchronises with
+        real-time threads. This may briefly sleep to calibrate the cycle counter so
+        shouldn't be called from a real-time thread.
+    */
+    [[nodiscard]] overhead_stats get_overhead_stats();
+
+    /** Returns the overhead measured so far on the calling thread. */
+    [[nodiscard]] overhead_counts get_overhead_stats_for_thread();
+
+    //==============================================================================
+    //==============================================================================
+    /** Describes a violation passed to a violation_handler.
+        This is filled in without allocating so it can be passed on to a lock-free
+        logger or similar from the handler.
+     */
+    struct violation_record
+    {
+        /** The maximum number of stack frames captured. */
+        static constexpr std::size_t max_frames = 64;
+
+        check_flags check;                      /// The check that was violated
+        const char* function_name = nullptr;    /// The intercepted function
+        uint64_t thread_id = 0;                 /// The OS id of the violating thread
+        std::size_t size = 0;                   /// Bytes requested, 0 if not applicable
+        std::size_t alignment = 0;              /// Alignment requested, 0 if not applicable
+        std::size_t num_frames = 0;             /// The number of valid entries in frames
+        std::array<void*, max_frames> frames;   /// The unsymbolicated stack of the violation
+        char message[256] {};                   /// A preformatted, null-terminated description
+        const realtime_token* token = nullptr;  /// The token active when the violation happened, if any
+        const char* scope_label = nullptr;      /// The label of the innermost labelled realtime_context, if any
+    };
+
+    /** A function called for violations when using error_mode::callback.
+        This is called on the violating thread, outside of the real-time context.
+    */
+    using violation_handler = void (*) (const violation_record&, void* user_data);
+
+    /** Sets the handler called for violations when using error_mode::callback.
+        This should be set before any threads are using the callback error mode.
+        If no handler is set, the callback mode behaves the same as error_mode::cont.
+    */
+    void set_violation_handler (violation_handler, void* user_data = nullptr);
+
+    /** Appends a raw record of every violation to a log file for processing offline
+        with the rtcheck-report tool.
+        Each record holds the unsymbolicated stack along with the load addresses of
+        the modules, and the time taken by the intercepted call if the process
+        continues. When the log is enabled, the stack trace isn't symbolicated and
+        printed in-process, which removes the biggest cost of reporting a violation.
+        Any %p in the path is replaced by the process id. This can also be set with
+        the RTCHECK_LOG_FILE environment variable. Passing nullptr closes the log.
+        Returns false if the file couldn't be opened.
+    */
+    bool set_violation_log_file (const char* path);
+
+    //==============================================================================
+    //==============================================================================
+    /** Options for the watchdog thread. */
+    struct watchdog_options
+    {
+        /** How long a thread can stay in a single real-time context before it's reported. */
+        std::chrono::microseconds threshold { std::chrono::milliseconds (10) };
+
+        /** How often the watchdog checks the real-time threads. */
+        std::chrono::microseconds poll_interval { std::chrono::milliseconds (1) };
+
+        /** The signal used to capture the stack of a stalled thread. */
+        int signal = SIGURG;
+    };
+
+    /** Starts a watchdog thread that detects real-time threads that have stayed in a
+        single realtime_context for longer than the threshold.
+        This catches hangs in code that isn't intercepted such as spin loops, page
+        faults or waiting in the kernel. The stalled thread is sent a signal which
+        captures its current stack and the stall is reported as a check_flags::stall
+        violation using the global error mode.
+        Stalls are reported from the watchdog thread, so the violation handler runs
+        there and error_mode::exit calls std::exit from it. error_mode::trap sends
+        SIGTRAP to the stalled thread without capturing its stack.
+        Returns false if the watchdog is already running or couldn't be started.
+    */
+    bool start_watchdog (watchdog_options = {});
+
+    /** Stops the watchdog thread if it's running. */
+    void stop_watchdog();
+
+    //==============================================================================
+    //==============================================================================
+    /** Options for the rt_log drain thread. */
+    struct rt_log_options
+    {
+        /** The file descriptor the messages are written to. */
+        int fd = STDERR_FILENO;
+
+        /** How often the queues are drained. */
+        std::chrono::microseconds poll_interval { std::chrono::milliseconds (10) };
+    };
+
+    /** Formats a message, printf style, that's written by a background thread.
+        Unlike logging inside a non_realtime_context, this is safe to call from a
+        real-time context: the message is formatted straight in to a preallocated
+        queue for the calling thread with no locks, allocations or system calls.
+        Messages longer than 239 characters are truncated. If the thread's queue is
+        full or start_rt_log hasn't been called, the message is dropped and the
+        number dropped is reported with the next messages written.
+    */
+    void rt_log (const char* format, ...) __attribute__ ((format (printf, 1, 2)));
+
+    /** Allocates the rt_log queues and starts the thread that drains them.
+        Messages are written in time order, prefixed with the time since this was
+        first called and the thread id. Any remaining messages are written at exit.
+        Returns false if the drain thread is already running.
+    */
+    bool start_rt_log (rt_log_options = {});
+
+    /** Stops the drain thread after writing the queued messages.
+        The queues are kept so later messages are queued until flush_rt_log is
+        called or the log is started again.
+    */
+    void stop_rt_log();
+
+    /** Writes all the queued messages now.
+        This must not be called in a real-time context.
+    */
+    void flush_rt_log();
+
+    //==============================================================================
+    //==============================================================================
+    /** Starts reporting lazily bound symbols that are resolved whilst in a realtime_context.
+        The first call through an unresolved PLT entry goes through the dynamic linker
+        which takes the loader lock and can allocate. This finds the unresolved GOT
+        entries of all the currently loaded modules and checks the ones that are still
+        unresolved each time a real-time context is entered or exited, reporting any
+        that have changed as check_flags::lazy_binding violations.
+        As resolutions are found when the scope is entered or exited, the violation's
+        stack is that of the realtime_context or non_realtime_context, not the call
+        through the PLT. The violation's function_name is the resolved symbol.
+        Modules loaded after this is called aren't checked, call it again to include
+        them. The modules that are checked are kept loaded.
+        As the GOT is shared, a symbol resolved by another thread whilst this thread
+        is in a real-time context will also be reported.
+        Returns false if this isn't supported on this platform (currently linux only).
+    */
+    bool enable_lazy_binding_check();
+
+    /** Stops checking for lazily bound symbols. */
+    void disable_lazy_binding_check();
+
+    //==============================================================================
+    //==============================================================================
+    /** Prepares the calling thread to run real-time code.
+        This writes to the next stack_bytes of the thread's stack so the pages are
+        mapped before the real-time code needs them and, if heap_prefault_bytes is
+        non-zero, allocates and touches a block of that size so the allocator's heap
+        is mapped.
+        If keep_heap_mapped is true, glibc's malloc is also stopped from trimming or
+        using mmap so the heap stays mapped. This changes malloc's settings for the
+        whole process so is off by default.
+        This doesn't lock memory itself as that's a process-wide decision and usually
+        needs privileges, but checks mlockall (MCL_CURRENT | MCL_FUTURE) is in effect.
+        Returns true if the stack was prefaulted to the requested depth and memory is
+        locked. This must not be called in a real-time context.
+    */
+    bool prepare_realtime_thread (std::size_t stack_bytes = 256 * 1024, std::size_t heap_prefault_bytes = 0,
+                                  bool keep_heap_mapped = false);
+
+    /** Starts reporting threads that enter a realtime_context without having called
+        prepare_realtime_thread or whilst memory isn't locked, as
+        check_flags::unprepared_thread violations.
+        Each thread is checked the first time it enters a real-time context after
+        this is enabled or after it's prepared. Memory locking is only checked on linux,
+        when this is called and by prepare_realtime_thread, so the real-time threads
+        only read the result.
+    */
+    void enable_thread_preparation_check();
+
+    /** Stops checking real-time threads have been prepared. */
+    void disable_thread_preparation_check();
+
+    //==============================================================================
+    //==============================================================================
+    /** Options for the sampling profiler. */
+    struct profiler_options
+    {
+        /** The amount of CPU time a thread uses between samples. */
+        std::chrono::microseconds interval { std::chrono::milliseconds (1) };
+
+        /** The maximum number of samples held before they're collected by write_folded_stacks. */
+        std::size_t buffer_size = 16384;
+
+        /** The signal used to take the samples. */
+        int signal = SIGPROF;
+    };
+
+    /** Starts a sampling profiler that only samples threads whilst they're in a
+        realtime_context.
+        Each thread arms a CPU-time timer when it enters a real-time context and
+        disarms it on exit so only the time spent in real-time scopes is profiled.
+        Samples are taken by walking frame pointers so the code being profiled
+        should be compiled with -fno-omit-frame-pointer.
+        Returns false if the profiler is already running or isn't supported on this
+        platform (currently linux only).
+    */
+    bool start_profiler (profiler_options = {});
+
+    /** Stops the profiler. Samples already taken can still be written. */
+    void stop_profiler();
+
+    /** Writes the samples taken so far as folded stacks, suitable for creating
+        flame graphs. Each line contains the semi-colon separated frames from the
+        root to the leaf followed by the number of samples with that stack.
+    */
+    void write_folded_stacks (std::ostream&);
 }
@@ -0,0 +1,109 @@
+#pragma once
+
+//==============================================================================
+/** The registry of every individual check.
+    Each entry is X (name, group, platform) where group is one of the check_group
+    enumerators and platform is one of the check_platform enumerators. The
+    check_id, check_flags members, names, group masks and suppression names are
+    all generated from this list. The interceptors that report each check are
+    still written by hand.
+    New checks must be added at the end, whatever their group, so the indices
+    written to violation logs and the bits in uint64_t masks stay the same.
+*/
+#define RTCHECK_CHECKS(X) \
+    /* memory */ \
+    X (malloc,                  memory,             any) \
+    X (calloc,                  memory,             any) \
+    X (realloc,                 memory,             any) \
+    X (reallocf,                memory,             apple_only) \
+    X (valloc,                  memory,             any) \
+    X (free,                    memory,             any) \
+    X (posix_memalign,          memory,             any) \
+    X (mmap,                    memory,             any) \
+    X (munmap,                  memory,             any) \
+    /* threads */ \
+    X (pthread_create,          threads,            any) \
+    X (pthread_mutex_lock,      threads,            any) \
+    X (pthread_mutex_unlock,    threads,            any) \
+    X (pthread_join,            threads,            any) \
+    X (pthread_cond_signal,     threads,            any) \
+    X (pthread_cond_broadcast,  threads,            any) \
+    X (pthread_cond_wait,       threads,            any) \
+    X (pthread_rwlock_init,     threads,            any) \
+    X (pthread_rwlock_destroy,  threads,            any) \
+    X (pthread_cond_timedwait,  threads,            any) \
+    X (pthread_rwlock_rdlock,   threads,            any) \
+    X (pthread_rwlock_unlock,   threads,            any) \
+    X (pthread_rwlock_wrlock,   threads,            any) \
+    X (pthread_spin_lock,       threads,            linux_only) \
+    X (futex,                   threads,            linux_only) /* decoded from syscall */ \
+    X (OSSpinLockLock,          threads,            apple_only) \
+    X (os_unfair_lock_lock,     threads,            apple_only) \
+    X (_os_nospin_lock_lock,    threads,            apple_only) \
+    /* sleeping */ \
+    X (sleep,                   sleeping,           any) \
+    X (usleep,                  sleeping,           any) \
+    X (nanosleep,               sleeping,           any) \
+    /* files, fcntl has never been part of the files group */ \
+    X (stat,                    files,              any) \
+    X (fstat,                   files,              any) \
+    X (open,                    files,              any) \
+    X (fopen,                   files,              any) \
+    X (openat,                  files,              any) \
+    X (fcntl,                   none,               any) \
+    /* system */ \
+    X (schedule,                sys,                linux_only) \
+    X (context_switch,          sys,                linux_only) \
+    X (syscall,                 sys,                any) \
+    /* memory, after the original checks so their bits in uint64_t masks don't move */ \
+    X (aligned_alloc,           memory,             any) \
+    X (memalign,                memory,             linux_only) \
+    X (pvalloc,                 memory,             linux_only) \
+    X (strdup,                  memory,             any) \
+    X (strndup,                 memory,             any) \
+    X (malloc_usable_size,      memory,             linux_only) \
+    X (operator_new,            memory,             any) \
+    X (operator_delete,         memory,             any) \
+    /* log_function_if_realtime_context */ \
+    X (custom,                  none,               any) \
+    /* start_watchdog */ \
+    X (stall,                   none,               any) \
+    /* contended pthread_mutex_lock held by a lower priority thread */ \
+    X (priority_inversion,      none,               any) \
+    /* lock-based libatomic calls */ \
+    X (atomic,                  none,               linux_only) \
+    /* dynamic loading */ \
+    X (dlopen,                  dynamic_loading,    any) \
+    X (dlmopen,                 dynamic_loading,    linux_only) \
+    X (dlsym,                   dynamic_loading,    linux_only) \
+    X (dlclose,                 dynamic_loading,    any) \
+    X (dl_iterate_phdr,         dynamic_loading,    linux_only) \
+    /* enable_lazy_binding_check */ \
+    X (lazy_binding,            none,               linux_only) \
+    /* enable_thread_preparation_check */ \
+    X (unprepared_thread,       none,               any) \
+    /* blocking waits and yields */ \
+    X (sched_yield,             waiting,            any) \
+    X (clock_nanosleep,         sleeping,           linux_only) \
+    X (poll,                    waiting,            any) \
+    X (ppoll,                   waiting,            linux_only) \
+    X (select,                  waiting,            any) \
+    X (pselect,                 waiting,            any) \
+    X (epoll_wait,              waiting,            linux_only) \
+    X (sem_wait,                waiting,            any) \
+    X (sem_timedwait,           waiting,            linux_only) \
+    X (pthread_barrier_wait,    waiting,            linux_only) \
+    /* any of the waits above made with a zero timeout so they don't block */ \
+    X (nonblocking_wait,        waiting,            any) \
+    /* syscall (SYS_futex) operations that wake rather than wait, reported instead of futex */ \
+    X (futex_wake,              threads,            linux_only)
+
+/** The groups of checks that can be enabled or disabled together. */
+#define RTCHECK_CHECK_GROUPS(X) \
+    X (memory) \
+    X (threads) \
+    X (sleeping) \
+    X (files) \
+    X (sys) \
+    X (dynamic_loading) \
+    X (waiting)
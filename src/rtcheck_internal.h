@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <pthread.h>
+#include <time.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+ #include <x86intrin.h>
+#endif
+
+#include "rtcheck.h"
+
+//==============================================================================
+// Internal details shared between the rtcheck translation units.
+//==============================================================================
+namespace rtc
+{
+constexpr auto to_underlying (auto e)
+{
+    return static_cast<std::underlying_type_t<decltype(e)>> (e);
+}
+
+/** Returns the OS id of the calling thread. */
+uint64_t get_thread_id();
+
+/** Returns the index of a single check in check_flags. */
+constexpr std::size_t get_check_index (const check_flags& flag)
+{
+    for (std::size_t i = 0; i < check_flags::num_words; ++i)
+        if (flag.words[i] != 0)
+            return i * 64 + static_cast<std::size_t> (std::countr_zero (flag.words[i]));
+
+    return 0;
+}
+
+//==============================================================================
+/** Additional information about an intercepted call that is added to the report. */
+struct call_details
+{
+    std::size_t size = 0;       /// Number of bytes requested, 0 if not applicable
+    std::size_t alignment = 0;  /// Requested alignment, 0 if not applicable
+    bool zero_timeout = false;  /// A wait that returns immediately rather than blocking
+    const void* caller = nullptr;   /// The return address of the intercepted call, if known
+};
+
+//==============================================================================
+/** The parts of rtcheck that are timed by overhead accounting. */
+enum class overhead_category
+{
+    hook,           /// An interceptor or log_function_if_realtime_context
+    stack_capture,  /// Capturing the stack of a violation
+    reporting,      /// Logging and reporting a violation
+    realtime_scope  /// The whole of a realtime_context, which the others are compared to
+};
+
+constexpr std::size_t num_overhead_categories = 4;
+
+/** Set whilst overhead accounting is enabled. This is checked inline by the hooks. */
+inline std::atomic<bool> overhead_accounting_enabled { false };
+
+/** Reads the CPU's cycle counter, or a nanosecond clock if there isn't one.
+    The ticks are converted to time when the overhead is read.
+*/
+inline uint64_t read_cycle_counter()
+{
+   #if defined (__x86_64__) || defined (__i386__)
+    return __rdtsc();
+   #elif defined (__aarch64__)
+    uint64_t ticks;
+    asm volatile ("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+   #else
+    return static_cast<uint64_t> (std::chrono::steady_clock::now().time_since_epoch().count());
+   #endif
+}
+
+/** Returns the steady clock time in nanoseconds. */
+inline int64_t get_time_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//==============================================================================
+using violation_count_array = std::array<std::atomic<uint64_t>, num_checks>;
+
+/**
+    State for a thread that needs to be readable from other threads.
+    A slot is claimed by a thread the first time it's needed and returned when
+    the thread exits. Only the owning thread writes the violation counts so these
+    are updated with relaxed loads and stores rather than read-modify-writes.
+*/
+struct alignas (64) thread_slot
+{
+    std::atomic<bool> in_use { false };
+    std::atomic<uint64_t> thread_id { 0 };
+    pthread_t thread {};
+    violation_count_array violation_counts {};
+    violation_count_array violation_baseline {};  /// Written by reset_violation_stats
+
+    //==============================================================================
+    // Watchdog heartbeat, written by the owning thread
+    std::atomic<uint64_t> scope_sequence { 0 };     /// Incremented on each scope entry
+    std::atomic<int64_t> scope_start_ns { 0 };      /// 0 when not in a real-time scope
+
+    // Stall capture, requested by the watchdog and filled in by its signal handler
+    std::atomic<uint64_t> stall_count { 0 };        /// Added to by the watchdog, read as part of the stall check's count
+    std::atomic<uint64_t> stall_requested { 0 };
+    std::atomic<uint64_t> stall_captured { 0 };
+    std::array<void*, violation_record::max_frames> stall_frames {};
+    std::size_t stall_num_frames = 0;
+
+    //==============================================================================
+    // Set by prepare_realtime_thread, only accessed by the owning thread
+    std::size_t prepared_stack_bytes = 0;
+    uint64_t preparation_check_generation = 0;  /// The check generation this thread was last checked in
+
+    //==============================================================================
+    // Cycle measurements, only written by the owning thread
+    std::atomic<uint64_t> cycle_reset_generation { 0 };
+    std::atomic<int64_t> cycle_period_ns { 0 };
+    std::atomic<uint64_t> num_cycles { 0 }, num_overruns { 0 };
+    std::atomic<int64_t> max_jitter_ns { 0 };
+    std::atomic<uint32_t> current_overrun_streak { 0 }, longest_overrun_streak { 0 };
+    std::array<std::atomic<uint64_t>, cycle_stats::num_jitter_buckets> jitter_histogram {};
+    std::array<std::atomic<uint64_t>, cycle_stats::num_load_buckets> load_histogram {};
+    std::array<std::atomic<uint64_t>, cycle_stats::num_overrun_streak_buckets> overrun_streak_histogram {};
+    int64_t expected_cycle_start_ns = 0;
+
+    //==============================================================================
+    // Overhead accounting in read_cycle_counter ticks, only written by the owning thread
+    std::array<std::atomic<uint64_t>, num_overhead_categories> overhead_ticks {};
+    std::atomic<uint64_t> num_hook_calls { 0 }, max_hook_ticks { 0 };
+
+   #if __linux__
+    //==============================================================================
+    // Profiler timer, only accessed by the owning thread and its signal handlers
+    timer_t profiler_timer {};
+    bool has_profiler_timer = false;
+    bool profiler_timer_armed = false;
+
+    // Set by cache_stack_bounds so signal handlers can walk the stack
+    std::uintptr_t stack_begin = 0, stack_end = 0;
+   #endif
+};
+
+constexpr std::size_t max_thread_slots = 256;
+
+/** Returns all the thread slots. */
+std::array<thread_slot, max_thread_slots>& get_thread_slots();
+
+/** Returns the slot for the calling thread, claiming one if necessary.
+    This can return nullptr if all the slots are in use.
+*/
+thread_slot* get_thread_slot();
+
+/** Returns the slot for the calling thread if it has already claimed one. */
+thread_slot* get_thread_slot_if_claimed();
+
+#if __linux__
+/** Records the bounds of the calling thread's stack in its slot, if it hasn't already.
+    This can allocate so must be called before entering a real-time context.
+*/
+void cache_stack_bounds (thread_slot&);
+
+/** Walks the frame pointer chain from the ucontext passed to a SA_SIGINFO signal
+    handler, only following frame pointers within the slot's stack. This is
+    async-signal-safe. Returns the number of frames written.
+*/
+std::size_t walk_frame_pointers (const void* context, const thread_slot*, void** frames, std::size_t max_frames);
+#endif
+
+/** Clears the cycle stats of a slot that is being claimed or released. */
+void clear_cycle_stats (thread_slot&);
+
+/** Adds the ticks spent in part of rtcheck to the overhead of the thread owning the slot.
+    This must only be called from the owning thread.
+*/
+void add_overhead (thread_slot&, overhead_category, uint64_t ticks);
+
+/** Called when a thread slot is released to add its overhead to the retired totals. */
+void overhead_release_thread (thread_slot&);
+
+/** Enables overhead accounting if the RTCHECK_OVERHEAD environment variable is set. */
+void load_overhead_options_from_environment();
+
+/** Increments a violation count for the thread owning the slot.
+    This must only be called from the owning thread.
+*/
+void increment_violation_count (thread_slot&, check_flags);
+
+/** Counts a stall for the thread owning the slot.
+    Unlike increment_violation_count this is called from the watchdog thread.
+*/
+void increment_stall_count (thread_slot&);
+
+//==============================================================================
+#if __linux__
+/** Returns the next definition of a function after rtcheck.
+    This bypasses the dlsym interceptor.
+*/
+void* get_real_function (const char* name);
+#endif
+
+/** Writes all of the data to a file descriptor, retrying if it's interrupted. */
+void write_all (int fd, const char* data, std::size_t size);
+
+/** Appends formatted text to a fixed size buffer, truncating if it's full. */
+struct line_buffer
+{
+    template<typename... Args>
+    void append (const char* format, Args... args)
+    {
+        if (size >= sizeof (data) - 1)
+            return;
+
+        if (const auto written = std::snprintf (data + size, sizeof (data) - size, format, args...); written > 0)
+            size = std::min (size + static_cast<std::size_t> (written), sizeof (data) - 1);
+    }
+
+    char data[2048];
+    std::size_t size = 0;
+};
+
+//==============================================================================
+/** Indexes the symbols of the loaded modules so that later stack traces can be
+    symbolicated without allocating. This is otherwise done on first use and
+    again whenever modules are loaded or unloaded.
+*/
+void warm_up_symbolizer();
+
+/** Writes a symbolicated stack trace for a set of frames to a file descriptor.
+    This doesn't allocate once the modules have been indexed and each function
+    name has been demangled once.
+*/
+void write_stacktrace (int fd, void* const* frames, std::size_t num_frames);
+
+/** Writes the demangled name of the function containing an address to a buffer,
+    returning its length. If the function can't be found, the module and offset
+    are written instead.
+*/
+std::size_t symbolize (const void* address, char* buffer, std::size_t buffer_size);
+
+/** Returns the demangled name of the function containing an address.
+    If the function can't be found, the module and offset are returned instead.
+*/
+std::string symbolize (const void* address);
+
+/** A function symbol in a loaded module. */
+struct function_symbol
+{
+    const char* module_path = nullptr;
+    std::uintptr_t module_begin = 0, module_end = 0;
+    std::uintptr_t address = 0;         /// The run-time address of the start of the function
+    const char* name = nullptr;         /// The mangled name
+};
+
+using function_callback = void (*) (const function_symbol&, void* user_data);
+
+/** Returns a number that changes whenever the symbol index is rebuilt because
+    modules have been loaded or unloaded. This rebuilds the index if needed.
+*/
+uint64_t get_symbolizer_generation();
+
+/** Calls a function for every function symbol in the symbol index. */
+void for_each_function (function_callback, void* user_data);
+
+/** Returns the start address of the function containing an address, or 0 if it
+    isn't known. This uses the index as it was when last checked so doesn't lock.
+*/
+std::uintptr_t find_function_start (const void* address);
+
+/** Finds the address range of the function containing an address. */
+bool find_function_range (const void* address, std::uintptr_t& begin, std::uintptr_t& end);
+
+/** Reports a violation on the calling thread if it's in a real-time context.
+    If message is nullptr, a description of the call is used instead.
+    Returns the id of the record written to the violation log or 0 if it wasn't logged.
+*/
+uint64_t log_violation (check_flags, const char* function_name, const call_details&, const char* message = nullptr);
+
+//==============================================================================
+/** Opens the violation log named by the RTCHECK_LOG_FILE environment variable. */
+void open_violation_log_from_environment();
+
+/** Returns true if violations are being written to a log file. */
+bool is_violation_log_enabled();
+
+/** Writes a violation to the log file and returns its id, or 0 if there's no log. */
+uint64_t write_violation_log_record (const violation_record&);
+
+/** Records the time taken by an intercepted call that was written to the violation log. */
+struct violation_cost_scope
+{
+    violation_cost_scope() = default;
+    explicit violation_cost_scope (uint64_t log_id);
+    ~violation_cost_scope();
+
+    violation_cost_scope (const violation_cost_scope&) = delete;
+    violation_cost_scope& operator= (const violation_cost_scope&) = delete;
+
+    uint64_t log_id = 0;
+    int64_t start_ns = 0;
+};
+
+//==============================================================================
+/** Trusts the modules named by the RTCHECK_TRUSTED_MODULES environment variable. */
+void load_trusted_modules_from_environment();
+
+/** Updates the ranges of the trusted modules after modules are loaded or unloaded. */
+void update_trusted_modules();
+
+/** Returns true if an address is inside a trusted module or address range. */
+bool is_trusted_caller (const void* return_address);
+
+//==============================================================================
+/** Loads the suppression file named by the RTCHECK_SUPPRESSIONS environment variable. */
+void load_suppressions_from_environment();
+
+/** Returns true if a violation of a check with the given stack has been suppressed. */
+bool is_suppressed (check_flags, void* const* frames, std::size_t num_frames);
+
+/** Parses a '|' separated list of check or group names, returning an empty set if any are unknown. */
+check_flags parse_checks (std::string_view);
+
+//==============================================================================
+/** Loads the policies from the RTCHECK_POLICY and RTCHECK_POLICY_FILE environment variables. */
+void load_check_policies_from_environment();
+
+/** Returns the error mode to use for a violation of a check with a policy that reports it. */
+error_mode get_error_mode_for_policy (check_policy, error_mode);
+
+/** Returns true the first time a check is violated at a call site, for check_policy::log_once. */
+bool is_first_violation_at_site (check_flags, std::uintptr_t site);
+
+/** Carries out the error mode for a violation that has already been detected.
+    error_mode::trap should be handled by the caller as this depends on where
+    the violation happened.
+*/
+void report_violation (const violation_record&, error_mode);
+
+//==============================================================================
+/** Called when the calling thread enters or exits a real-time context. */
+void watchdog_scope_enter();
+void watchdog_scope_exit();
+
+void profiler_scope_enter();
+void profiler_scope_exit();
+
+/** Called when a thread slot is released. */
+void profiler_release_thread (thread_slot&);
+
+/** Reports any lazily bound symbols that have been resolved since the last call.
+    These are only reported if the calling thread is in a real-time context.
+*/
+void lazy_binding_check();
+
+/** Reports the calling thread if it hasn't been prepared for real-time use.
+    This must be called after entering a real-time context.
+*/
+void thread_preparation_check();
+
+//==============================================================================
+using mutex_lock_function = int (*) (pthread_mutex_t*);
+
+/** Locks a mutex from a real-time thread, reporting a check_flags::priority_inversion
+    violation if it had to wait for a thread with a lower scheduling priority.
+*/
+int lock_mutex_checking_priority_inversion (pthread_mutex_t*, mutex_lock_function);
+
+/** Called by the mutex interceptors to keep track of mutex owners on platforms
+    where these can't be read from the mutex itself.
+*/
+void mutex_locked (pthread_mutex_t*);
+void mutex_unlocked (pthread_mutex_t*);
+}
@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if __has_include (<cxxabi.h>)
+ #include <cxxabi.h>
+#endif
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    /** Looks up a check or group by the name used in check_flags. */
+    check_flags find_check (std::string_view name)
+    {
+        for (std::size_t i = 0; i < num_checks; ++i)
+            if (name == check_infos[i].name)
+                return check_flags (static_cast<check_id> (i));
+
+       #define RTCHECK_FIND_GROUP(group) if (name == #group) return check_flags::group;
+        RTCHECK_CHECK_GROUPS (RTCHECK_FIND_GROUP)
+       #undef RTCHECK_FIND_GROUP
+
+        return {};
+    }
+
+    //==============================================================================
+    /** Returns true if the text matches a pattern where * matches any run of characters.
+        Patterns match anywhere in the text as though they start and end with a *.
+    */
+    bool matches_pattern (std::string_view text, std::string_view pattern)
+    {
+        std::size_t position = 0;
+
+        while (! pattern.empty())
+        {
+            const auto star = pattern.find ('*');
+            const auto part = pattern.substr (0, star);
+            pattern = star == std::string_view::npos ? std::string_view() : pattern.substr (star + 1);
+
+            if (part.empty())
+                continue;
+
+            if (position = text.find (part, position); position == std::string_view::npos)
+                return false;
+
+            position += part.size();
+        }
+
+        return true;
+    }
+
+    struct suppression_rule
+    {
+        check_flags checks;
+        bool is_module = false;     /// Matches the module's path rather than the function name
+        std::string pattern;
+        std::vector<std::string> identifiers;   /// Must all appear in a mangled name for it to be worth demangling
+    };
+
+    /** Rules compiled against the functions and modules loaded when they were built. */
+    struct compiled_suppressions
+    {
+        uint64_t generation = 0;
+        std::unordered_map<std::uintptr_t, check_flags> functions;     /// Checks suppressed by function start address
+
+        struct module_range
+        {
+            std::uintptr_t begin = 0, end = 0;
+            check_flags checks;
+        };
+
+        std::vector<module_range> modules;
+    };
+
+    struct suppression_state
+    {
+        /// All the checks that have rules, for a quick reject
+        std::array<std::atomic<uint64_t>, check_flags::num_words> checks {};
+        std::atomic<const compiled_suppressions*> compiled { nullptr };
+
+        // Compiled suppressions are never freed as other threads may still be reading them
+        std::mutex mutex;
+        std::vector<suppression_rule> rules;
+        std::vector<std::unique_ptr<compiled_suppressions>> all_compiled;
+    };
+
+    suppression_state& get_suppression_state()
+    {
+        static suppression_state state;
+        return state;
+    }
+
+    //==============================================================================
+    /** Returns true if an identifier always appears verbatim in a mangled name.
+        Keywords, builtin types and the std names that have abbreviations don't.
+    */
+    bool is_mangled_verbatim (std::string_view identifier)
+    {
+        constexpr std::string_view encoded[] =
+        {
+            "operator", "const", "volatile", "unsigned", "signed", "void", "bool", "char", "short", "int", "long",
+            "float", "double", "wchar_t", "char8_t", "char16_t", "char32_t", "anonymous", "namespace",
+            "std", "allocator", "basic_string", "string", "char_traits", "basic_istream", "basic_ostream",
+            "basic_iostream", "istream", "ostream", "iostream"
+        };
+
+        return std::find (std::begin (encoded), std::end (encoded), identifier) == std::end (encoded);
+    }
+
+    /** Returns the identifiers in a pattern that must appear in a mangled name for it to match. */
+    std::vector<std::string> get_identifiers (std::string_view pattern)
+    {
+        std::vector<std::string> identifiers;
+        std::string current;
+
+        auto add_current = [&]
+        {
+            if (! current.empty() && is_mangled_verbatim (current))
+                identifiers.push_back (current);
+
+            current.clear();
+        };
+
+        for (auto c : pattern)
+        {
+            if (std::isalnum (static_cast<unsigned char> (c)) || c == '_')
+                current += c;
+            else
+                add_current();
+        }
+
+        add_current();
+
+        return identifiers;
+    }
+
+    struct compile_context
+    {
+        const std::vector<suppression_rule>& rules;
+        compiled_suppressions& compiled;
+        std::uintptr_t last_module_begin = 0;
+        std::string demangled;
+    };
+
+    void compile_function (const function_symbol& function, void* user_data)
+    {
+        auto& context = *static_cast<compile_context*> (user_data);
+        const std::string_view name (function.name);
+        const bool is_mangled = name.starts_with ("_Z");
+        bool is_demangled = false;
+
+        // Functions are visited module by module so each module only needs matching once
+        const bool is_new_module = function.module_begin != context.last_module_begin;
+        context.last_module_begin = function.module_begin;
+
+        for (auto& rule : context.rules)
+        {
+            if (rule.is_module)
+            {
+                if (is_new_module && matches_pattern (function.module_path, rule.pattern))
+                    context.compiled.modules.push_back ({ function.module_begin, function.module_end, rule.checks });
+
+                continue;
+            }
+
+            if (! is_mangled)
+            {
+                if (matches_pattern (name, rule.pattern))
+                    context.compiled.functions[function.address] |= rule.checks;
+
+                continue;
+            }
+
+            // Most names can be rejected without demangling them
+            if (! std::all_of (rule.identifiers.begin(), rule.identifiers.end(),
+                               [name] (auto& identifier) { return name.find (identifier) != std::string_view::npos; }))
+                continue;
+
+            if (! is_demangled)
+            {
+                int status = 0;
+                std::unique_ptr<char, decltype (&std::free)> demangled (abi::__cxa_demangle (function.name, nullptr, nullptr, &status), &std::free);
+                context.demangled = status == 0 && demangled != nullptr ? demangled.get() : function.name;
+                is_demangled = true;
+            }
+
+            if (matches_pattern (context.demangled, rule.pattern))
+                context.compiled.functions[function.address] |= rule.checks;
+        }
+    }
+
+    /** Returns the suppressions compiled for the currently loaded modules. */
+    const compiled_suppressions* get_compiled_suppressions()
+    {
+        auto& state = get_suppression_state();
+        const auto generation = get_symbolizer_generation();
+
+        if (auto compiled = state.compiled.load (std::memory_order_acquire); compiled != nullptr && compiled->generation == generation)
+            return compiled;
+
+        std::scoped_lock lock (state.mutex);
+
+        if (auto compiled = state.compiled.load (std::memory_order_acquire); compiled != nullptr && compiled->generation == generation)
+            return compiled;
+
+        auto compiled = std::make_unique<compiled_suppressions>();
+        compiled->generation = generation;
+
+        compile_context context { state.rules, *compiled, 0, {} };
+        for_each_function (compile_function, &context);
+
+        state.compiled.store (compiled.get(), std::memory_order_release);
+        state.all_compiled.push_back (std::move (compiled));
+
+        return state.all_compiled.back().get();
+    }
+}
+
+//==============================================================================
+check_flags parse_checks (std::string_view text)
+{
+    check_flags checks;
+
+    while (! text.empty())
+    {
+        const auto separator = text.find ('|');
+        const auto name = text.substr (0, separator);
+        text = separator == std::string_view::npos ? std::string_view() : text.substr (separator + 1);
+
+        if (name == "all" || name == "*")
+        {
+            checks = check_flags::all();
+            continue;
+        }
+
+        const auto check = find_check (name);
+
+        if (check.none())
+            return {};
+
+        checks |= check;
+    }
+
+    return checks;
+}
+
+bool load_suppressions (const char* path)
+{
+   #if __linux__
+    std::ifstream file (path);
+
+    if (! file)
+        return false;
+
+    std::vector<suppression_rule> rules;
+    check_flags all_checks;
+    int line_number = 0;
+
+    for (std::string line; std::getline (file, line);)
+    {
+        ++line_number;
+        std::string_view text (line);
+
+        if (auto comment = text.find ('#'); comment != std::string_view::npos)
+            text = text.substr (0, comment);
+
+        while (! text.empty() && std::isspace (static_cast<unsigned char> (text.back())))
+            text.remove_suffix (1);
+
+        while (! text.empty() && std::isspace (static_cast<unsigned char> (text.front())))
+            text.remove_prefix (1);
+
+        if (text.empty())
+            continue;
+
+        const auto colon = text.find (':');
+        suppression_rule rule;
+
+        if (colon != std::string_view::npos)
+            rule.checks = parse_checks (text.substr (0, colon));
+
+        if (rule.checks.none())
+        {
+            std::cerr << "rtcheck: ignoring invalid suppression at " << path << ':' << line_number << '\n';
+            continue;
+        }
+
+        auto pattern = text.substr (colon + 1);
+
+        if (pattern.starts_with ("module:"))
+        {
+            rule.is_module = true;
+            pattern.remove_prefix (7);
+        }
+
+        rule.pattern = pattern;
+        rule.identifiers = get_identifiers (pattern);
+        all_checks |= rule.checks;
+        rules.push_back (std::move (rule));
+    }
+
+    auto& state = get_suppression_state();
+
+    {
+        std::scoped_lock lock (state.mutex);
+        state.rules.insert (state.rules.end(), rules.begin(), rules.end());
+        state.compiled.store (nullptr, std::memory_order_release);
+    }
+
+    for (std::size_t i = 0; i < check_flags::num_words; ++i)
+        state.checks[i].fetch_or (all_checks.words[i], std::memory_order_release);
+
+    // Compile the rules now so the first violation doesn't have to
+    get_compiled_suppressions();
+
+    return true;
+   #else
+    (void) path;
+    return false;
+   #endif
+}
+
+void load_suppressions_from_environment()
+{
+    if (const char* path = std::getenv ("RTCHECK_SUPPRESSIONS"); path != nullptr && path[0] != 0)
+        if (! load_suppressions (path))
+            std::cerr << "rtcheck: unable to load suppressions from " << path << '\n';
+}
+
+bool is_suppressed (check_flags flag, void* const* frames, std::size_t num_frames)
+{
+    const auto index = get_check_index (flag);
+
+    if (((get_suppression_state().checks[index / 64].load (std::memory_order_acquire) >> (index % 64)) & 1) == 0)
+        return false;
+
+    auto compiled = get_compiled_suppressions();
+
+    for (std::size_t i = 0; i < num_frames; ++i)
+    {
+        // Frames are return addresses so look up the call instruction before them
+        const auto pc = static_cast<const char*> (frames[i]) - 1;
+        const auto address = reinterpret_cast<std::uintptr_t> (pc);
+
+        for (auto& module : compiled->modules)
+            if (address >= module.begin && address < module.end && module.checks.test (index))
+                return true;
+
+        if (auto it = compiled->functions.find (find_function_start (pc));
+            it != compiled->functions.end() && it->second.test (index))
+            return true;
+    }
+
+    return false;
+}
+}
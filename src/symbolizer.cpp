@@ -0,0 +1,563 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __linux__
+ #include <elf.h>
+ #include <link.h>
+#endif
+
+#if __has_include (<cxxabi.h>)
+ #include <cxxabi.h>
+#endif
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    /** Returns a demangled copy of a name that is never freed, or nullptr if it isn't mangled. */
+    const char* demangle (const char* name)
+    {
+       #if __has_include (<cxxabi.h>)
+        int status = 0;
+
+        if (auto demangled = abi::__cxa_demangle (name, nullptr, nullptr, &status); status == 0)
+            return demangled;
+       #endif
+
+        return nullptr;
+    }
+
+    std::string_view get_file_name (std::string_view path)
+    {
+        if (auto last_slash = path.rfind ('/'); last_slash != std::string_view::npos)
+            return path.substr (last_slash + 1);
+
+        return path;
+    }
+
+    std::size_t copy_string (std::string_view text, char* buffer, std::size_t buffer_size)
+    {
+        if (buffer_size == 0)
+            return 0;
+
+        const auto size = std::min (text.size(), buffer_size - 1);
+        std::memcpy (buffer, text.data(), size);
+        buffer[size] = 0;
+
+        return size;
+    }
+
+    std::size_t format_module_offset (std::string_view module, std::size_t offset, char* buffer, std::size_t buffer_size)
+    {
+        const auto written = std::snprintf (buffer, buffer_size, "%.*s+0x%zx",
+                                            static_cast<int> (module.size()), module.data(), offset);
+
+        return written > 0 ? std::min (static_cast<std::size_t> (written), buffer_size - 1) : 0;
+    }
+
+   #if __linux__
+    //==============================================================================
+    struct symbol
+    {
+        std::uintptr_t address = 0, size = 0;
+        const char* name = nullptr;
+        mutable std::atomic<const char*> demangled { nullptr };   /// Filled in the first time it's used
+    };
+
+    struct file_symbol
+    {
+        std::uintptr_t address = 0, size = 0;
+        const char* name = nullptr;
+    };
+
+    /** The function symbols of a loaded module, sorted by run-time address.
+        The names point in to the module's file which is left mapped.
+    */
+    struct module_symbols
+    {
+        std::uintptr_t begin = 0, end = 0, load_bias = 0;
+        std::string path;
+        std::unique_ptr<symbol[]> symbols;
+        std::size_t num_symbols = 0;
+
+        const symbol* find (std::uintptr_t address) const
+        {
+            auto last = symbols.get() + num_symbols;
+            auto it = std::upper_bound (symbols.get(), last, address,
+                                        [] (std::uintptr_t a, const symbol& s) { return a < s.address; });
+
+            if (it == symbols.get())
+                return nullptr;
+
+            --it;
+
+            // Symbols without a size are matched up to the next symbol
+            if (it->size != 0 && address >= it->address + it->size)
+                return nullptr;
+
+            return it;
+        }
+    };
+
+    /** The modules that were loaded when the index was built, sorted by address. */
+    struct symbol_index
+    {
+        std::vector<const module_symbols*> modules;
+        unsigned long long loader_adds = 0, loader_subs = 0;
+        uint64_t generation = 0;
+
+        const module_symbols* find (std::uintptr_t address) const
+        {
+            auto it = std::upper_bound (modules.begin(), modules.end(), address,
+                                        [] (std::uintptr_t a, const module_symbols* m) { return a < m->begin; });
+
+            if (it == modules.begin() || address >= (*--it)->end)
+                return nullptr;
+
+            return *it;
+        }
+    };
+
+    struct symbolizer_state
+    {
+        std::atomic<const symbol_index*> index { nullptr };
+
+        // Indexes and modules are never freed as other threads may still be reading
+        // them and a module's demangled names are shared by every index it's in
+        std::mutex mutex;
+        std::vector<std::unique_ptr<symbol_index>> indexes;
+        std::vector<std::unique_ptr<module_symbols>> modules;
+    };
+
+    symbolizer_state& get_symbolizer_state()
+    {
+        static symbolizer_state state;
+        return state;
+    }
+
+    using dl_iterate_phdr_function = int (*) (int (*) (dl_phdr_info*, size_t, void*), void*);
+
+    dl_iterate_phdr_function get_real_dl_iterate_phdr()
+    {
+        static auto real_dl_iterate_phdr = reinterpret_cast<dl_iterate_phdr_function> (get_real_function ("dl_iterate_phdr"));
+        return real_dl_iterate_phdr;
+    }
+
+    //==============================================================================
+    /** Maps a file and adds its function symbols. The file is left mapped for the names. */
+    template<typename Header, typename SectionHeader, typename Symbol>
+    void read_symbols (const char* file, std::size_t file_size, std::uintptr_t load_bias, std::vector<file_symbol>& symbols)
+    {
+        const auto& header = *reinterpret_cast<const Header*> (file);
+
+        if (header.e_shoff == 0 || header.e_shentsize != sizeof (SectionHeader)
+            || header.e_shoff + header.e_shnum * sizeof (SectionHeader) > file_size)
+            return;
+
+        auto sections = reinterpret_cast<const SectionHeader*> (file + header.e_shoff);
+
+        for (std::size_t i = 0; i < header.e_shnum; ++i)
+        {
+            const auto& section = sections[i];
+
+            if ((section.sh_type != SHT_SYMTAB && section.sh_type != SHT_DYNSYM)
+                || section.sh_link >= header.e_shnum
+                || section.sh_offset + section.sh_size > file_size)
+                continue;
+
+            const auto& strings = sections[section.sh_link];
+
+            if (strings.sh_offset + strings.sh_size > file_size || strings.sh_size == 0
+                || file[strings.sh_offset + strings.sh_size - 1] != 0)
+                continue;
+
+            auto entries = reinterpret_cast<const Symbol*> (file + section.sh_offset);
+
+            for (std::size_t j = 0; j < section.sh_size / sizeof (Symbol); ++j)
+            {
+                const auto& entry = entries[j];
+
+                if ((entry.st_info & 0xf) != STT_FUNC || entry.st_value == 0 || entry.st_name >= strings.sh_size)
+                    continue;
+
+                auto& s = symbols.emplace_back();
+                s.address = load_bias + entry.st_value;
+                s.size = entry.st_size;
+                s.name = file + strings.sh_offset + entry.st_name;
+            }
+        }
+    }
+
+    void read_module_symbols (module_symbols& module)
+    {
+        const auto fd = ::open (module.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            return;
+
+        struct stat file_info {};
+        void* mapping = MAP_FAILED;
+
+        if (fstat (fd, &file_info) == 0 && file_info.st_size >= static_cast<off_t> (EI_NIDENT))
+            mapping = mmap (nullptr, static_cast<std::size_t> (file_info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+        ::close (fd);
+
+        if (mapping == MAP_FAILED)
+            return;
+
+        const auto file = static_cast<const char*> (mapping);
+        const auto file_size = static_cast<std::size_t> (file_info.st_size);
+        std::vector<file_symbol> symbols;
+
+        if (std::memcmp (file, ELFMAG, SELFMAG) == 0 && file[EI_CLASS] == ELFCLASS64 && file_size >= sizeof (Elf64_Ehdr))
+            read_symbols<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym> (file, file_size, module.load_bias, symbols);
+        else if (std::memcmp (file, ELFMAG, SELFMAG) == 0 && file[EI_CLASS] == ELFCLASS32 && file_size >= sizeof (Elf32_Ehdr))
+            read_symbols<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym> (file, file_size, module.load_bias, symbols);
+
+        if (symbols.empty())
+        {
+            munmap (mapping, file_size);
+            return;
+        }
+
+        // .symtab and .dynsym overlap so keep one symbol per address, preferring sized ones
+        std::sort (symbols.begin(), symbols.end(),
+                   [] (auto& a, auto& b) { return a.address < b.address || (a.address == b.address && a.size > b.size); });
+
+        module.symbols = std::make_unique<symbol[]> (symbols.size());
+
+        for (auto& s : symbols)
+        {
+            if (module.num_symbols > 0 && module.symbols[module.num_symbols - 1].address == s.address)
+                continue;
+
+            auto& dest = module.symbols[module.num_symbols++];
+            dest.address = s.address;
+            dest.size = s.size;
+            dest.name = s.name;
+        }
+    }
+
+    //==============================================================================
+    struct index_builder
+    {
+        symbolizer_state& state;
+        const symbol_index* previous;
+        symbol_index& index;
+    };
+
+    int add_module (dl_phdr_info* info, size_t size, void* data)
+    {
+        auto& builder = *static_cast<index_builder*> (data);
+
+        if (size >= offsetof (dl_phdr_info, dlpi_subs) + sizeof (info->dlpi_subs))
+        {
+            builder.index.loader_adds = info->dlpi_adds;
+            builder.index.loader_subs = info->dlpi_subs;
+        }
+
+        std::uintptr_t begin = UINTPTR_MAX, end = 0;
+
+        for (int i = 0; i < info->dlpi_phnum; ++i)
+        {
+            if (const auto& header = info->dlpi_phdr[i]; header.p_type == PT_LOAD)
+            {
+                begin = std::min (begin, static_cast<std::uintptr_t> (info->dlpi_addr + header.p_vaddr));
+                end = std::max (end, static_cast<std::uintptr_t> (info->dlpi_addr + header.p_vaddr + header.p_memsz));
+            }
+        }
+
+        if (begin >= end)
+            return 0;
+
+        // Modules that are still loaded at the same place are reused along with their demangled names
+        if (builder.previous != nullptr)
+        {
+            if (auto existing = builder.previous->find (begin); existing != nullptr
+                && existing->begin == begin && existing->end == end && existing->load_bias == info->dlpi_addr)
+            {
+                builder.index.modules.push_back (existing);
+                return 0;
+            }
+        }
+
+        auto module = std::make_unique<module_symbols>();
+        module->begin = begin;
+        module->end = end;
+        module->load_bias = info->dlpi_addr;
+
+        if (info->dlpi_name != nullptr && info->dlpi_name[0] != 0)
+        {
+            module->path = info->dlpi_name;
+        }
+        else
+        {
+            char executable_path[1024];
+            const auto length = readlink ("/proc/self/exe", executable_path, sizeof (executable_path) - 1);
+            module->path.assign (executable_path, static_cast<std::size_t> (std::max (length, ssize_t (0))));
+        }
+
+        read_module_symbols (*module);
+
+        builder.index.modules.push_back (module.get());
+        builder.state.modules.push_back (std::move (module));
+
+        return 0;
+    }
+
+    int read_loader_counts (dl_phdr_info* info, size_t size, void* data)
+    {
+        if (size >= offsetof (dl_phdr_info, dlpi_subs) + sizeof (info->dlpi_subs))
+        {
+            auto counts = static_cast<unsigned long long*> (data);
+            counts[0] = info->dlpi_adds;
+            counts[1] = info->dlpi_subs;
+        }
+
+        // Only the first module is needed
+        return 1;
+    }
+
+    /** Returns the index for the currently loaded modules, rebuilding it if any have
+        been loaded or unloaded since it was built.
+    */
+    const symbol_index& get_symbol_index()
+    {
+        auto& state = get_symbolizer_state();
+        auto index = state.index.load (std::memory_order_acquire);
+
+        unsigned long long counts[2] = {};
+        get_real_dl_iterate_phdr() (read_loader_counts, counts);
+
+        if (index != nullptr && index->loader_adds == counts[0] && index->loader_subs == counts[1])
+            return *index;
+
+        std::scoped_lock lock (state.mutex);
+        index = state.index.load (std::memory_order_acquire);
+
+        if (index != nullptr && index->loader_adds == counts[0] && index->loader_subs == counts[1])
+            return *index;
+
+        auto new_index = std::make_unique<symbol_index>();
+        index_builder builder { state, index, *new_index };
+        get_real_dl_iterate_phdr() (add_module, &builder);
+
+        std::sort (new_index->modules.begin(), new_index->modules.end(),
+                   [] (auto a, auto b) { return a->begin < b->begin; });
+        new_index->generation = state.indexes.size() + 1;
+
+        state.index.store (new_index.get(), std::memory_order_release);
+        state.indexes.push_back (std::move (new_index));
+
+        return *state.indexes.back();
+    }
+
+    std::size_t symbolize (const symbol_index& index, const void* address, char* buffer, std::size_t buffer_size)
+    {
+        const auto pc = reinterpret_cast<std::uintptr_t> (address);
+        auto module = index.find (pc);
+
+        if (module == nullptr)
+        {
+            const auto written = std::snprintf (buffer, buffer_size, "%p", address);
+            return written > 0 ? std::min (static_cast<std::size_t> (written), buffer_size - 1) : 0;
+        }
+
+        if (auto s = module->find (pc))
+        {
+            auto name = s->demangled.load (std::memory_order_acquire);
+
+            if (name == nullptr)
+            {
+                // Names that don't demangle are cached as themselves
+                auto demangled = demangle (s->name);
+                const char* expected = nullptr;
+
+                if (! s->demangled.compare_exchange_strong (expected, demangled != nullptr ? demangled : s->name,
+                                                            std::memory_order_acq_rel))
+                    std::free (const_cast<char*> (demangled));
+
+                name = s->demangled.load (std::memory_order_acquire);
+            }
+
+            return copy_string (name, buffer, buffer_size);
+        }
+
+        return format_module_offset (get_file_name (module->path), pc - module->load_bias, buffer, buffer_size);
+    }
+   #endif
+}
+
+//==============================================================================
+#if __linux__
+void warm_up_symbolizer()
+{
+    get_symbol_index();
+}
+
+std::size_t symbolize (const void* address, char* buffer, std::size_t buffer_size)
+{
+    return symbolize (get_symbol_index(), address, buffer, buffer_size);
+}
+
+void write_stacktrace (int fd, void* const* frames, std::size_t num_frames)
+{
+    auto& index = get_symbol_index();
+
+    for (std::size_t i = 0; i < num_frames; ++i)
+    {
+        line_buffer line;
+        line.append ("%*s", static_cast<int> (i), "");
+
+        // All the frames are return addresses so look up the call instruction before them
+        line.size += symbolize (index, static_cast<const char*> (frames[i]) - 1,
+                                line.data + line.size, sizeof (line.data) - line.size - 1);
+        line.append ("\n");
+        write_all (fd, line.data, line.size);
+    }
+
+    write_all (fd, "\n", 1);
+}
+
+uint64_t get_symbolizer_generation()
+{
+    return get_symbol_index().generation;
+}
+
+void for_each_function (function_callback callback, void* user_data)
+{
+    for (auto module : get_symbol_index().modules)
+    {
+        for (std::size_t i = 0; i < module->num_symbols; ++i)
+        {
+            const auto& s = module->symbols[i];
+            callback ({ module->path.c_str(), module->begin, module->end, s.address, s.name }, user_data);
+        }
+    }
+}
+
+bool find_function_range (const void* address, std::uintptr_t& begin, std::uintptr_t& end)
+{
+    const auto pc = reinterpret_cast<std::uintptr_t> (address);
+    auto module = get_symbol_index().find (pc);
+
+    if (module == nullptr)
+        return false;
+
+    auto s = module->find (pc);
+
+    if (s == nullptr)
+        return false;
+
+    begin = s->address;
+
+    // Symbols without a size extend to the next symbol or the end of the module
+    if (s->size != 0)
+        end = s->address + s->size;
+    else if (s + 1 < module->symbols.get() + module->num_symbols)
+        end = (s + 1)->address;
+    else
+        end = module->end;
+
+    return true;
+}
+
+std::uintptr_t find_function_start (const void* address)
+{
+    auto index = get_symbolizer_state().index.load (std::memory_order_acquire);
+    const auto pc = reinterpret_cast<std::uintptr_t> (address);
+
+    if (index == nullptr)
+        return 0;
+
+    if (auto module = index->find (pc))
+        if (auto s = module->find (pc))
+            return s->address;
+
+    return 0;
+}
+#else
+void warm_up_symbolizer()
+{
+}
+
+uint64_t get_symbolizer_generation()                { return 0; }
+void for_each_function (function_callback, void*)   {}
+std::uintptr_t find_function_start (const void*)    { return 0; }
+
+bool find_function_range (const void* address, std::uintptr_t& begin, std::uintptr_t& end)
+{
+    Dl_info info;
+
+    if (dladdr (address, &info) == 0 || info.dli_saddr == nullptr)
+        return false;
+
+    // The size isn't known so only the start of the function can be used
+    begin = reinterpret_cast<std::uintptr_t> (info.dli_saddr);
+    end = begin + 1;
+
+    return true;
+}
+
+std::size_t symbolize (const void* address, char* buffer, std::size_t buffer_size)
+{
+    Dl_info info;
+
+    if (dladdr (address, &info) == 0)
+    {
+        const auto written = std::snprintf (buffer, buffer_size, "%p", address);
+        return written > 0 ? std::min (static_cast<std::size_t> (written), buffer_size - 1) : 0;
+    }
+
+    if (info.dli_sname != nullptr)
+    {
+        const char* demangled = demangle (info.dli_sname);
+        const auto size = copy_string (demangled != nullptr ? demangled : info.dli_sname, buffer, buffer_size);
+        std::free (const_cast<char*> (demangled));
+
+        return size;
+    }
+
+    return format_module_offset (get_file_name (info.dli_fname != nullptr ? info.dli_fname : ""),
+                                 static_cast<std::size_t> (static_cast<const char*> (address) - static_cast<const char*> (info.dli_fbase)),
+                                 buffer, buffer_size);
+}
+
+void write_stacktrace (int fd, void* const* frames, std::size_t num_frames)
+{
+    for (std::size_t i = 0; i < num_frames; ++i)
+    {
+        line_buffer line;
+        line.append ("%*s", static_cast<int> (i), "");
+        line.size += symbolize (static_cast<const char*> (frames[i]) - 1,
+                                line.data + line.size, sizeof (line.data) - line.size - 1);
+        line.append ("\n");
+        write_all (fd, line.data, line.size);
+    }
+
+    write_all (fd, "\n", 1);
+}
+#endif
+
+std::string symbolize (const void* address)
+{
+    char buffer[1024];
+    const auto size = symbolize (address, buffer, sizeof (buffer));
+
+    return std::string (buffer, size);
+}
+}
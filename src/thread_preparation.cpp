@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <alloca.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if __linux__
+ #include <malloc.h>
+#endif
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    std::atomic<bool>& get_thread_preparation_check_enabled()
+    {
+        static std::atomic<bool> enabled { false };
+        return enabled;
+    }
+
+    /** Incremented by enable_thread_preparation_check so every thread is checked again. */
+    std::atomic<uint64_t>& get_thread_preparation_check_generation()
+    {
+        static std::atomic<uint64_t> generation { 0 };
+        return generation;
+    }
+
+    /** Whether mlockall was in effect when last checked.
+        This is worked out outside of real-time contexts as it reads /proc and maps memory.
+    */
+    std::atomic<bool>& get_memory_locked_flag()
+    {
+        static std::atomic<bool> is_locked { false };
+        return is_locked;
+    }
+
+    std::size_t get_page_size()
+    {
+        static const auto page_size = static_cast<std::size_t> (sysconf (_SC_PAGESIZE));
+        return page_size;
+    }
+
+    //==============================================================================
+    /** Returns the number of bytes between the current stack position and the end of
+        the stack, excluding a margin for the functions called whilst prefaulting.
+    */
+    std::size_t get_available_stack_bytes()
+    {
+        constexpr std::size_t margin = 64 * 1024;
+        char here = 0;
+        std::uintptr_t stack_begin = 0;
+
+       #if __APPLE__
+        stack_begin = reinterpret_cast<std::uintptr_t> (pthread_get_stackaddr_np (pthread_self()))
+                        - pthread_get_stacksize_np (pthread_self());
+       #else
+        if (pthread_attr_t attr; pthread_getattr_np (pthread_self(), &attr) == 0)
+        {
+            void* stack_address = nullptr;
+            std::size_t stack_size = 0;
+
+            if (pthread_attr_getstack (&attr, &stack_address, &stack_size) == 0)
+                stack_begin = reinterpret_cast<std::uintptr_t> (stack_address);
+
+            pthread_attr_destroy (&attr);
+        }
+       #endif
+
+        const auto current = reinterpret_cast<std::uintptr_t> (&here);
+
+        if (stack_begin == 0 || current < stack_begin + margin)
+            return 0;
+
+        return current - stack_begin - margin;
+    }
+
+    /** Writes to every page of the next num_bytes of stack so they're mapped before
+        the real-time code needs them.
+    */
+    [[gnu::noinline]] void prefault_stack (std::size_t num_bytes)
+    {
+        auto stack = static_cast<volatile char*> (alloca (num_bytes));
+
+        for (std::size_t i = 0; i < num_bytes; i += get_page_size())
+            stack[i] = 0;
+
+        stack[num_bytes - 1] = 0;
+    }
+
+    /** Stops glibc's malloc from returning memory to the system or using mmap for
+        large blocks, otherwise prefaulted heap pages could be unmapped again.
+        This affects every thread in the process.
+    */
+    void keep_heap_mapped()
+    {
+       #if defined (__GLIBC__)
+        mallopt (M_TRIM_THRESHOLD, -1);
+        mallopt (M_MMAP_MAX, 0);
+       #endif
+    }
+
+    /** Allocates, touches and frees a block so the allocator's heap is mapped. */
+    void prefault_heap (std::size_t num_bytes)
+    {
+        if (auto heap = static_cast<volatile char*> (std::malloc (num_bytes)))
+        {
+            for (std::size_t i = 0; i < num_bytes; i += get_page_size())
+                heap[i] = 0;
+
+            std::free (const_cast<char*> (heap));
+        }
+    }
+
+    //==============================================================================
+    /** Returns true if mlockall (MCL_CURRENT | MCL_FUTURE) appears to be in effect.
+        MCL_CURRENT is inferred from the process having locked memory and
+        MCL_FUTURE from a new mapping being resident without being touched.
+    */
+    bool is_memory_locked()
+    {
+       #if __linux__
+        std::ifstream status ("/proc/self/status");
+        std::size_t locked_kb = 0;
+
+        for (std::string line; std::getline (status, line);)
+            if (line.starts_with ("VmLck:"))
+                locked_kb = std::strtoull (line.c_str() + 6, nullptr, 10);
+
+        if (locked_kb == 0)
+            return false;
+
+        const auto page_size = get_page_size();
+        auto probe = mmap (nullptr, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (probe == MAP_FAILED)
+            return false;
+
+        unsigned char residency = 0;
+        const bool is_resident = mincore (probe, page_size, &residency) == 0 && (residency & 1) != 0;
+        munmap (probe, page_size);
+
+        return is_resident;
+       #else
+        // Memory locking can't be checked on this platform
+        return true;
+       #endif
+    }
+}
+
+//==============================================================================
+bool prepare_realtime_thread (std::size_t stack_bytes, std::size_t heap_prefault_bytes, bool should_keep_heap_mapped)
+{
+    assert (! is_real_time_context() && "prepare_realtime_thread can't be called in a real-time context");
+
+    const auto available_stack_bytes = get_available_stack_bytes();
+    const auto stack_bytes_to_prefault = std::min (stack_bytes, available_stack_bytes);
+
+    if (stack_bytes_to_prefault > 0)
+        prefault_stack (stack_bytes_to_prefault);
+
+    if (should_keep_heap_mapped)
+        keep_heap_mapped();
+
+    if (heap_prefault_bytes > 0)
+        prefault_heap (heap_prefault_bytes);
+
+    // Reports from the real-time context can then be symbolicated without reading the modules
+    warm_up_symbolizer();
+
+    if (auto slot = get_thread_slot())
+    {
+        slot->prepared_stack_bytes = stack_bytes_to_prefault;
+        slot->preparation_check_generation = 0;
+    }
+
+    const bool is_locked = is_memory_locked();
+    get_memory_locked_flag().store (is_locked, std::memory_order_relaxed);
+
+    return stack_bytes_to_prefault == stack_bytes && is_locked;
+}
+
+void enable_thread_preparation_check()
+{
+    get_memory_locked_flag().store (is_memory_locked(), std::memory_order_relaxed);
+    get_thread_preparation_check_generation().fetch_add (1, std::memory_order_relaxed);
+    get_thread_preparation_check_enabled().store (true, std::memory_order_release);
+}
+
+void disable_thread_preparation_check()
+{
+    get_thread_preparation_check_enabled().store (false, std::memory_order_relaxed);
+}
+
+void thread_preparation_check()
+{
+    if (! get_thread_preparation_check_enabled().load (std::memory_order_acquire))
+        return;
+
+    if (! is_check_enabled_for_thread (check_flags::unprepared_thread))
+        return;
+
+    auto slot = get_thread_slot();
+
+    // Each thread is only checked once, until it's prepared or the check is enabled again
+    if (slot == nullptr)
+        return;
+
+    const auto generation = get_thread_preparation_check_generation().load (std::memory_order_relaxed);
+
+    if (slot->preparation_check_generation == generation)
+        return;
+
+    slot->preparation_check_generation = generation;
+
+    const bool is_stack_prefaulted = slot->prepared_stack_bytes > 0;
+    const bool is_locked = get_memory_locked_flag().load (std::memory_order_relaxed);
+
+    if (is_stack_prefaulted && is_locked)
+        return;
+
+    char message[256];
+    std::snprintf (message, sizeof (message),
+                   "Real-time violation: thread %llu entered a real-time context %s%s%s!",
+                   static_cast<unsigned long long> (get_thread_id()),
+                   is_stack_prefaulted ? "" : "without its stack being prefaulted by prepare_realtime_thread",
+                   ! is_stack_prefaulted && ! is_locked ? " and " : "",
+                   is_locked ? "" : "without mlockall (MCL_CURRENT | MCL_FUTURE) in effect");
+
+    log_violation (check_flags::unprepared_thread, "realtime_context", {}, message);
+}
+}
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if __linux__
+ #include <link.h>
+#else
+ #include <mach-o/dyld.h>
+ #include <mach-o/getsect.h>
+#endif
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    struct address_range
+    {
+        std::uintptr_t begin = 0, end = 0;
+    };
+
+    /** The trusted ranges, sorted and merged so they can be binary searched. */
+    struct trusted_table
+    {
+        std::vector<address_range> ranges;
+
+        bool contains (std::uintptr_t address) const
+        {
+            auto it = std::upper_bound (ranges.begin(), ranges.end(), address,
+                                        [] (std::uintptr_t a, const address_range& r) { return a < r.begin; });
+
+            return it != ranges.begin() && address < (--it)->end;
+        }
+    };
+
+    struct trusted_state
+    {
+        std::atomic<const trusted_table*> table { nullptr };
+        std::atomic<bool> has_modules { false };
+
+        // Tables are never freed as other threads may still be reading them
+        std::mutex mutex;
+        std::vector<std::string> module_names;
+        std::vector<address_range> ranges;
+        std::vector<std::unique_ptr<trusted_table>> tables;
+    };
+
+    trusted_state& get_trusted_state()
+    {
+        static trusted_state state;
+        return state;
+    }
+
+    //==============================================================================
+    struct module_matcher
+    {
+        const std::vector<std::string>& names;
+        std::vector<address_range>& ranges;
+    };
+
+    bool matches_module_name (std::string_view path, const std::vector<std::string>& names)
+    {
+        return std::any_of (names.begin(), names.end(),
+                            [path] (auto& name) { return path.find (name) != std::string_view::npos; });
+    }
+
+   #if __linux__
+    int add_module_if_trusted (dl_phdr_info* info, size_t, void* data)
+    {
+        auto& matcher = *static_cast<module_matcher*> (data);
+        const std::string_view path (info->dlpi_name != nullptr && info->dlpi_name[0] != 0 ? info->dlpi_name
+                                                                                          : program_invocation_name);
+
+        if (! matches_module_name (path, matcher.names))
+            return 0;
+
+        for (int i = 0; i < info->dlpi_phnum; ++i)
+        {
+            if (const auto& header = info->dlpi_phdr[i]; header.p_type == PT_LOAD && (header.p_flags & PF_X) != 0)
+            {
+                const auto begin = static_cast<std::uintptr_t> (info->dlpi_addr + header.p_vaddr);
+                matcher.ranges.push_back ({ begin, begin + header.p_memsz });
+            }
+        }
+
+        return 0;
+    }
+
+    void add_trusted_modules (module_matcher& matcher)
+    {
+        static auto real_dl_iterate_phdr = reinterpret_cast<int (*) (int (*) (dl_phdr_info*, size_t, void*), void*)> (get_real_function ("dl_iterate_phdr"));
+        real_dl_iterate_phdr (add_module_if_trusted, &matcher);
+    }
+   #else
+    void add_trusted_modules (module_matcher& matcher)
+    {
+        for (uint32_t i = 0; i < _dyld_image_count(); ++i)
+        {
+            if (! matches_module_name (_dyld_get_image_name (i), matcher.names))
+                continue;
+
+            auto header = reinterpret_cast<const mach_header_64*> (_dyld_get_image_header (i));
+            unsigned long size = 0;
+
+            if (auto text = getsegmentdata (header, "__TEXT", &size))
+                matcher.ranges.push_back ({ reinterpret_cast<std::uintptr_t> (text), reinterpret_cast<std::uintptr_t> (text) + size });
+        }
+    }
+   #endif
+
+    /** Rebuilds and publishes the table. This must be called with the lock held. */
+    void rebuild_trusted_table (trusted_state& state)
+    {
+        auto table = std::make_unique<trusted_table>();
+        table->ranges = state.ranges;
+
+        if (! state.module_names.empty())
+        {
+            module_matcher matcher { state.module_names, table->ranges };
+            add_trusted_modules (matcher);
+        }
+
+        auto& ranges = table->ranges;
+        std::sort (ranges.begin(), ranges.end(), [] (auto& a, auto& b) { return a.begin < b.begin; });
+
+        // Merge overlapping ranges so a single binary search finds the range
+        std::vector<address_range> merged;
+
+        for (auto& r : ranges)
+        {
+            if (! merged.empty() && r.begin <= merged.back().end)
+                merged.back().end = std::max (merged.back().end, r.end);
+            else
+                merged.push_back (r);
+        }
+
+        ranges = std::move (merged);
+
+        state.table.store (table.get(), std::memory_order_release);
+        state.tables.push_back (std::move (table));
+    }
+}
+
+//==============================================================================
+void trust_module (const char* name)
+{
+    auto& state = get_trusted_state();
+    std::scoped_lock lock (state.mutex);
+
+    state.module_names.emplace_back (name);
+    state.has_modules.store (true, std::memory_order_relaxed);
+    rebuild_trusted_table (state);
+}
+
+void trust_address_range (const void* begin, const void* end)
+{
+    auto& state = get_trusted_state();
+    std::scoped_lock lock (state.mutex);
+
+    state.ranges.push_back ({ reinterpret_cast<std::uintptr_t> (begin), reinterpret_cast<std::uintptr_t> (end) });
+    rebuild_trusted_table (state);
+}
+
+bool trust_function (const void* function)
+{
+    std::uintptr_t begin = 0, end = 0;
+
+    if (! find_function_range (function, begin, end))
+        return false;
+
+    trust_address_range (reinterpret_cast<const void*> (begin), reinterpret_cast<const void*> (end));
+    return true;
+}
+
+void load_trusted_modules_from_environment()
+{
+    const char* names = std::getenv ("RTCHECK_TRUSTED_MODULES");
+
+    if (names == nullptr)
+        return;
+
+    for (std::string_view remaining (names); ! remaining.empty();)
+    {
+        const auto separator = remaining.find (':');
+
+        if (const auto name = remaining.substr (0, separator); ! name.empty())
+            trust_module (std::string (name).c_str());
+
+        remaining = separator == std::string_view::npos ? std::string_view() : remaining.substr (separator + 1);
+    }
+}
+
+void update_trusted_modules()
+{
+    auto& state = get_trusted_state();
+
+    if (! state.has_modules.load (std::memory_order_relaxed))
+        return;
+
+    non_realtime_context nrc;
+    std::scoped_lock lock (state.mutex);
+    rebuild_trusted_table (state);
+}
+
+bool is_trusted_caller (const void* return_address)
+{
+    auto table = get_trusted_state().table.load (std::memory_order_acquire);
+
+    // The return address is after the call so look up the call instruction itself
+    return table != nullptr
+            && table->contains (reinterpret_cast<std::uintptr_t> (return_address) - 1);
+}
+}
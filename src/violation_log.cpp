@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+
+#if __linux__
+ #include <link.h>
+#endif
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    struct module_range
+    {
+        std::uintptr_t begin = 0, end = 0;
+    };
+
+    struct violation_log_state
+    {
+        // The descriptor to write to, or -1 whilst logging is disabled
+        std::atomic<int> fd { -1 };
+        std::atomic<uint64_t> next_id { 1 };
+
+        // Records are written whilst holding the lock, which is only taken outside of
+        // real-time contexts as writing the modules can take the loader lock
+        std::mutex mutex;
+
+        // Once opened, the descriptor is never closed as cost lines are written without
+        // the lock. Changing the file replaces the file it refers to instead.
+        int log_fd = -1;
+
+        // Ranges of the modules written to the log so frames in newly loaded
+        // modules can be detected. Only accessed whilst holding the lock.
+        std::array<module_range, 512> modules;
+        std::size_t num_modules = 0;
+    };
+
+    violation_log_state& get_violation_log_state()
+    {
+        static violation_log_state state;
+        return state;
+    }
+
+    /** Makes the log descriptor refer to a new file, taking ownership of new_fd.
+        This must be called with the lock held.
+    */
+    void replace_log_file (violation_log_state& state, int new_fd)
+    {
+        if (state.log_fd < 0)
+        {
+            state.log_fd = new_fd;
+            return;
+        }
+
+        // dup2 replaces the file atomically so a racing cost line goes to one file or the other
+        ::dup2 (new_fd, state.log_fd);
+        ::fcntl (state.log_fd, F_SETFD, FD_CLOEXEC);
+        ::close (new_fd);
+    }
+
+    //==============================================================================
+   #if __linux__
+    int write_module (dl_phdr_info* info, size_t, void* data)
+    {
+        auto& state = *static_cast<violation_log_state*> (data);
+        std::uintptr_t begin = UINTPTR_MAX, end = 0;
+
+        for (int i = 0; i < info->dlpi_phnum; ++i)
+        {
+            if (const auto& header = info->dlpi_phdr[i]; header.p_type == PT_LOAD)
+            {
+                begin = std::min (begin, static_cast<std::uintptr_t> (info->dlpi_addr + header.p_vaddr));
+                end = std::max (end, static_cast<std::uintptr_t> (info->dlpi_addr + header.p_vaddr + header.p_memsz));
+            }
+        }
+
+        if (begin >= end)
+            return 0;
+
+        for (std::size_t i = 0; i < state.num_modules; ++i)
+            if (state.modules[i].begin == begin && state.modules[i].end == end)
+                return 0;
+
+        if (state.num_modules < state.modules.size())
+            state.modules[state.num_modules++] = { begin, end };
+
+        // The executable doesn't have a name so find its path instead
+        const char* path = info->dlpi_name;
+        char executable_path[1024];
+
+        if (path == nullptr || path[0] == 0)
+        {
+            const auto length = readlink ("/proc/self/exe", executable_path, sizeof (executable_path) - 1);
+            executable_path[length > 0 ? length : 0] = 0;
+            path = executable_path;
+        }
+
+        line_buffer line;
+        line.append ("module %zx %zx %zx %s\n",
+                     static_cast<std::size_t> (info->dlpi_addr), static_cast<std::size_t> (begin),
+                     static_cast<std::size_t> (end), path);
+        write_all (state.fd.load (std::memory_order_relaxed), line.data, line.size);
+
+        return 0;
+    }
+   #endif
+
+    /** Writes any modules that haven't been written to the log yet. */
+    void write_modules (violation_log_state& state)
+    {
+       #if __linux__
+        static auto real_dl_iterate_phdr = reinterpret_cast<int (*) (int (*) (dl_phdr_info*, size_t, void*), void*)> (get_real_function ("dl_iterate_phdr"));
+        real_dl_iterate_phdr (write_module, &state);
+       #else
+        (void) state;
+       #endif
+    }
+
+    bool is_in_written_module (const violation_log_state& state, const void* address)
+    {
+        const auto pc = reinterpret_cast<std::uintptr_t> (address);
+
+        for (std::size_t i = 0; i < state.num_modules; ++i)
+            if (pc >= state.modules[i].begin && pc < state.modules[i].end)
+                return true;
+
+        return false;
+    }
+}
+
+//==============================================================================
+void write_all (int fd, const char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        const auto written = ::write (fd, data, size);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0)
+            return;
+
+        data += written;
+        size -= static_cast<std::size_t> (written);
+    }
+}
+
+//==============================================================================
+bool set_violation_log_file (const char* path)
+{
+    auto& state = get_violation_log_state();
+    std::scoped_lock lock (state.mutex);
+
+    state.fd.store (-1, std::memory_order_release);
+    state.num_modules = 0;
+
+    // The old file is closed by pointing the descriptor at /dev/null
+    if (state.log_fd >= 0)
+        if (const auto null_fd = ::open ("/dev/null", O_WRONLY | O_CLOEXEC); null_fd >= 0)
+            replace_log_file (state, null_fd);
+
+    if (path == nullptr || path[0] == 0)
+        return true;
+
+    // %p is replaced with the process id so each process writes to its own log
+    std::string file_path (path);
+
+    if (const auto pid_pos = file_path.find ("%p"); pid_pos != std::string::npos)
+        file_path.replace (pid_pos, 2, std::to_string (getpid()));
+
+    const auto fd = ::open (file_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+        return false;
+
+    replace_log_file (state, fd);
+
+    char header[64];
+    const auto header_size = std::snprintf (header, sizeof (header), "rtcheck-log 1 %d\n", static_cast<int> (getpid()));
+    write_all (state.log_fd, header, static_cast<std::size_t> (header_size));
+
+    state.fd.store (state.log_fd, std::memory_order_release);
+    write_modules (state);
+
+    return true;
+}
+
+void open_violation_log_from_environment()
+{
+    if (const char* path = std::getenv ("RTCHECK_LOG_FILE"))
+        set_violation_log_file (path);
+}
+
+bool is_violation_log_enabled()
+{
+    return get_violation_log_state().fd.load (std::memory_order_relaxed) >= 0;
+}
+
+uint64_t write_violation_log_record (const violation_record& record)
+{
+    auto& state = get_violation_log_state();
+
+    if (state.fd.load (std::memory_order_acquire) < 0)
+        return 0;
+
+    std::scoped_lock lock (state.mutex);
+    const auto fd = state.fd.load (std::memory_order_relaxed);
+
+    if (fd < 0)
+        return 0;
+
+    for (std::size_t i = 0; i < record.num_frames; ++i)
+    {
+        if (! is_in_written_module (state, record.frames[i]))
+        {
+            write_modules (state);
+            break;
+        }
+    }
+
+    const auto id = state.next_id.fetch_add (1, std::memory_order_relaxed);
+
+    line_buffer line;
+    line.append ("violation %llu %zu %llu %zu %zu %zu",
+                 static_cast<unsigned long long> (id), get_check_index (record.check),
+                 static_cast<unsigned long long> (record.thread_id), record.size, record.alignment,
+                 record.num_frames);
+
+    for (std::size_t i = 0; i < record.num_frames; ++i)
+        line.append (" %zx", reinterpret_cast<std::size_t> (record.frames[i]));
+
+    // The function name goes last as it can contain spaces, e.g. operator new[]
+    line.append (" %s\n", record.function_name);
+
+    if (record.scope_label != nullptr)
+        line.append ("scope %llu %s\n", static_cast<unsigned long long> (id), record.scope_label);
+
+    write_all (fd, line.data, line.size);
+
+    return id;
+}
+
+//==============================================================================
+violation_cost_scope::violation_cost_scope (uint64_t id)
+    : log_id (id), start_ns (id != 0 ? get_time_ns() : 0)
+{
+}
+
+violation_cost_scope::~violation_cost_scope()
+{
+    if (log_id == 0)
+        return;
+
+    const auto fd = get_violation_log_state().fd.load (std::memory_order_acquire);
+
+    if (fd < 0)
+        return;
+
+    char line[64];
+    const auto size = std::snprintf (line, sizeof (line), "cost %llu %lld\n",
+                                     static_cast<unsigned long long> (log_id),
+                                     static_cast<long long> (get_time_ns() - start_ns));
+    write_all (fd, line, static_cast<std::size_t> (size));
+}
+}
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <thread>
+#include <execinfo.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "rtcheck_internal.h"
+
+namespace rtc
+{
+namespace
+{
+    struct watchdog_state
+    {
+        std::atomic<bool> running { false };
+        std::atomic<bool> should_stop { false };
+        watchdog_options options;
+        struct sigaction previous_action {};
+
+        // This is never destroyed by a static destructor so the error mode can
+        // safely call std::exit from the watchdog thread
+        std::thread* thread = nullptr;
+
+        // Only accessed by the watchdog thread
+        std::array<uint64_t, max_thread_slots> last_reported_sequence {};
+    };
+
+    watchdog_state& get_watchdog_state()
+    {
+        static watchdog_state state;
+        return state;
+    }
+
+    //==============================================================================
+    /** Signal handler run on the stalled thread to capture its stack.
+        On linux this walks the frame pointers from the interrupted context as
+        backtrace can take the loader lock, which the thread may be stalled in.
+        macOS's backtrace walks the frame pointers itself.
+    */
+    void capture_stall_stack (int, siginfo_t*, [[ maybe_unused ]] void* context)
+    {
+        const auto saved_errno = errno;
+        const auto tid = get_thread_id();
+
+        for (auto& slot : get_thread_slots())
+        {
+            if (! slot.in_use.load (std::memory_order_acquire)
+                || slot.thread_id.load (std::memory_order_relaxed) != tid)
+                continue;
+
+            if (const auto requested = slot.stall_requested.load (std::memory_order_acquire);
+                requested != slot.stall_captured.load (std::memory_order_relaxed))
+            {
+               #if __linux__
+                slot.stall_num_frames = walk_frame_pointers (context, &slot, slot.stall_frames.data(), slot.stall_frames.size());
+               #else
+                slot.stall_num_frames = static_cast<std::size_t> (backtrace (slot.stall_frames.data(), static_cast<int> (slot.stall_frames.size())));
+               #endif
+                slot.stall_captured.store (requested, std::memory_order_release);
+            }
+
+            break;
+        }
+
+        errno = saved_errno;
+    }
+
+    bool send_signal (const thread_slot& slot, int signal)
+    {
+       #if __APPLE__
+        return pthread_kill (slot.thread, signal) == 0;
+       #else
+        // tgkill is used rather than pthread_kill as the thread may have exited
+        return tgkill (getpid(), static_cast<pid_t> (slot.thread_id.load (std::memory_order_relaxed)), signal) == 0;
+       #endif
+    }
+
+    //==============================================================================
+    void report_stall (thread_slot& slot, int64_t duration_ns)
+    {
+        const auto& options = get_watchdog_state().options;
+        const auto policy = get_check_policy (check_id::stall);
+
+        if (policy == check_policy::ignore)
+            return;
+
+        if (policy == check_policy::count)
+        {
+            increment_stall_count (slot);
+            return;
+        }
+
+        const auto mode = get_error_mode_for_policy (policy, get_error_mode());
+
+        if (mode == error_mode::trap)
+        {
+            increment_stall_count (slot);
+            send_signal (slot, SIGTRAP);
+            return;
+        }
+
+        // Only the watchdog thread writes the request
+        const auto requested = slot.stall_requested.load (std::memory_order_relaxed) + 1;
+        slot.stall_requested.store (requested, std::memory_order_release);
+
+        bool captured = false;
+
+        if (send_signal (slot, options.signal))
+        {
+            for (int i = 0; i < 1000 && ! captured; ++i)
+            {
+                captured = slot.stall_captured.load (std::memory_order_acquire) == requested;
+
+                if (! captured)
+                    std::this_thread::sleep_for (std::chrono::microseconds (100));
+            }
+        }
+
+        violation_record record;
+        record.check = check_flags::stall;
+        record.function_name = "realtime_context";
+        record.thread_id = slot.thread_id.load (std::memory_order_relaxed);
+        record.num_frames = captured ? slot.stall_num_frames : 0;
+        std::copy_n (slot.stall_frames.begin(), record.num_frames, record.frames.begin());
+
+        if (is_suppressed (record.check, record.frames.data(), record.num_frames))
+            return;
+
+        increment_stall_count (slot);
+
+        std::snprintf (record.message, sizeof (record.message),
+                       "Real-time violation: thread %llu has been in a real-time context for %.3f ms, exceeding the watchdog threshold of %.3f ms!%s",
+                       static_cast<unsigned long long> (record.thread_id),
+                       static_cast<double> (duration_ns) / 1.0e6,
+                       static_cast<double> (options.threshold.count()) / 1.0e3,
+                       captured ? "" : " (stack could not be captured)");
+
+        write_violation_log_record (record);
+        report_violation (record, mode);
+    }
+
+    void run_watchdog()
+    {
+        auto& state = get_watchdog_state();
+        auto& slots = get_thread_slots();
+        const auto threshold_ns = std::chrono::duration_cast<std::chrono::nanoseconds> (state.options.threshold).count();
+
+        while (! state.should_stop.load (std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_for (state.options.poll_interval);
+            const auto now = get_time_ns();
+
+            for (std::size_t i = 0; i < slots.size(); ++i)
+            {
+                auto& slot = slots[i];
+
+                if (! slot.in_use.load (std::memory_order_relaxed))
+                    continue;
+
+                const auto sequence = slot.scope_sequence.load (std::memory_order_acquire);
+                const auto start = slot.scope_start_ns.load (std::memory_order_acquire);
+
+                if (start == 0 || now - start < threshold_ns
+                    || sequence != slot.scope_sequence.load (std::memory_order_acquire)
+                    || sequence == state.last_reported_sequence[i])
+                    continue;
+
+                state.last_reported_sequence[i] = sequence;
+                report_stall (slot, now - start);
+            }
+        }
+    }
+}
+
+//==============================================================================
+void watchdog_scope_enter()
+{
+    if (! get_watchdog_state().running.load (std::memory_order_relaxed))
+        return;
+
+    if (! is_check_enabled_for_thread (check_flags::stall))
+        return;
+
+    if (auto slot = get_thread_slot())
+    {
+       #if __linux__
+        cache_stack_bounds (*slot);
+       #endif
+
+        slot->scope_sequence.store (slot->scope_sequence.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        slot->scope_start_ns.store (get_time_ns(), std::memory_order_release);
+    }
+}
+
+void watchdog_scope_exit()
+{
+    if (auto slot = get_thread_slot_if_claimed())
+        slot->scope_start_ns.store (0, std::memory_order_relaxed);
+}
+
+//==============================================================================
+bool start_watchdog (watchdog_options options)
+{
+    auto& state = get_watchdog_state();
+
+    if (state.thread != nullptr)
+        return false;
+
+    struct sigaction action {};
+    action.sa_sigaction = capture_stall_stack;
+    action.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigemptyset (&action.sa_mask);
+
+    if (sigaction (options.signal, &action, &state.previous_action) != 0)
+        return false;
+
+    state.options = options;
+    state.should_stop.store (false, std::memory_order_relaxed);
+    state.thread = new std::thread (run_watchdog);
+    state.running.store (true, std::memory_order_relaxed);
+
+    return true;
+}
+
+void stop_watchdog()
+{
+    auto& state = get_watchdog_state();
+
+    if (state.thread == nullptr)
+        return;
+
+    state.running.store (false, std::memory_order_relaxed);
+    state.should_stop.store (true, std::memory_order_relaxed);
+    state.thread->join();
+    delete state.thread;
+    state.thread = nullptr;
+
+    sigaction (state.options.signal, &state.previous_action, nullptr);
+}
+}
@@ -0,0 +1,11 @@
+#include <stdlib.h>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+
+    [[ maybe_unused ]] volatile auto res = aligned_alloc (64, 1024);
+
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include <time.h>
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+int main()
+{
+    timespec req { 0, 1 };
+
+    rtc::realtime_context rc;
+    clock_nanosleep (CLOCK_MONOTONIC, 0, &req, nullptr);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,17 @@
+#include <rtcheck.h>
+
+#if ! __APPLE__
+ #include <link.h>
+#endif
+
+int main()
+{
+   #if __APPLE__
+    return 1;
+   #else
+    rtc::realtime_context rc;
+    dl_iterate_phdr ([] (dl_phdr_info*, size_t, void*) { return 1; }, nullptr);
+
+    return 0;
+   #endif
+}
@@ -0,0 +1,15 @@
+#include <dlfcn.h>
+#include <rtcheck.h>
+
+int main()
+{
+    auto handle = dlopen (RTCHECK_TEST_LIBRARY_PATH, RTLD_NOW);
+
+    if (handle == nullptr)
+        return 0;
+
+    rtc::realtime_context rc;
+    dlclose (handle);
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <dlfcn.h>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+    dlopen (RTCHECK_TEST_LIBRARY_PATH, RTLD_NOW);
+
+    // Reaching here means the violation wasn't reported, whether or not the library loaded
+    return 0;
+}
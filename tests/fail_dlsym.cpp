@@ -0,0 +1,19 @@
+#include <dlfcn.h>
+#include <rtcheck.h>
+
+int main()
+{
+   #if __APPLE__
+    return 1;
+   #else
+    auto handle = dlopen (RTCHECK_TEST_LIBRARY_PATH, RTLD_NOW);
+
+    if (handle == nullptr)
+        return 0;
+
+    rtc::realtime_context rc;
+    auto function = reinterpret_cast<int (*)()> (dlsym (handle, "rtcheck_test_library_function"));
+
+    return function != nullptr && function() == 42 ? 0 : 2;
+   #endif
+}
@@ -0,0 +1,26 @@
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+#include <sys/epoll.h>
+#include <unistd.h>
+
+int main()
+{
+    const auto fd = epoll_create1 (0);
+    epoll_event event;
+
+    {
+        rtc::realtime_context rc;
+        epoll_wait (fd, &event, 1, 1);
+    }
+
+    close (fd);
+
+    return 0;
+}
+#endif
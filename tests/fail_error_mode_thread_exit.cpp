@@ -0,0 +1,19 @@
+#include <memory>
+#include <thread>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::set_error_mode (rtc::error_mode::cont);
+
+    std::thread t ([]
+                   {
+                       rtc::set_error_mode_for_thread (rtc::error_mode::exit);
+
+                       rtc::realtime_context rc;
+                       [[ maybe_unused ]] volatile auto res = malloc (1024);
+                   });
+    t.join();
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int main()
+{
+    int word = 0;
+
+    rtc::realtime_context rc;
+
+    // The value doesn't match so this returns immediately if it isn't intercepted
+    syscall (SYS_futex, &word, FUTEX_WAIT_PRIVATE, 1, nullptr, nullptr, 0);
+
+    return 0;
+}
+#endif
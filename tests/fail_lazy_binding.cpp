@@ -0,0 +1,28 @@
+#include <dlfcn.h>
+#include <rtcheck.h>
+
+int main()
+{
+   #if __APPLE__
+    return 1;
+   #else
+    auto handle = dlopen (RTCHECK_TEST_LIBRARY_PATH, RTLD_LAZY);
+
+    if (handle == nullptr)
+        return 0;
+
+    auto lazy_call = reinterpret_cast<int (*)()> (dlsym (handle, "rtcheck_test_library_lazy_call"));
+
+    if (lazy_call == nullptr || ! rtc::enable_lazy_binding_check())
+        return 0;
+
+    // The library's call to getppid is resolved on first use
+    rtc::realtime_context rc;
+    rtc::disable_checks_for_thread (rtc::check_flags::sys);
+
+    lazy_call();
+
+    // Reaching here means the violation wasn't reported
+    return 0;
+   #endif
+}
@@ -0,0 +1,29 @@
+#include <atomic>
+#include <cassert>
+#include <rtcheck.h>
+
+struct doubles
+{
+    double d1[4];
+};
+
+int main()
+{
+   #if __APPLE__
+    // libatomic isn't used on macOS
+    return 1;
+   #else
+    std::atomic<doubles> a;
+    assert (! a.is_lock_free());
+
+    doubles d { 1.0, 2.0, 3.0, 4.0 };
+
+    rtc::realtime_context rc;
+
+    // Only the atomic check should catch this, not the lock libatomic takes
+    rtc::disable_checks_for_thread (rtc::check_flags::threads | rtc::check_flags::sys);
+    a.store (d);
+
+    return 0;
+   #endif
+}
@@ -0,0 +1,21 @@
+#include <memory>
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+#include <malloc.h>
+
+int main()
+{
+    auto res = malloc (1024);
+
+    rtc::realtime_context rc;
+    [[ maybe_unused ]] volatile auto size = malloc_usable_size (res);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,20 @@
+#include <memory>
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+#include <malloc.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+
+    [[ maybe_unused ]] volatile auto res = memalign (64, 1024);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,12 @@
+#include <memory>
+#include <rtcheck.h>
+
+int main()
+{
+    auto res = std::make_unique<int> (42);
+
+    rtc::realtime_context rc;
+    res.reset();
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <memory>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+
+    [[ maybe_unused ]] volatile auto res = new int (42);
+
+    return 0;
+}
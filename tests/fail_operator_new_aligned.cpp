@@ -0,0 +1,16 @@
+#include <memory>
+#include <rtcheck.h>
+
+struct alignas (64) aligned_block
+{
+    float data[16];
+};
+
+int main()
+{
+    rtc::realtime_context rc;
+
+    [[ maybe_unused ]] volatile auto res = new aligned_block[4];
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <new>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+
+    [[ maybe_unused ]] volatile auto res = new (std::nothrow) int[256];
+
+    return 0;
+}
@@ -0,0 +1,10 @@
+#include <poll.h>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+    poll (nullptr, 0, 1);
+
+    return 0;
+}
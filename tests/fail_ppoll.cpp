@@ -0,0 +1,20 @@
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+#include <poll.h>
+
+int main()
+{
+    timespec timeout { 0, 1000 };
+
+    rtc::realtime_context rc;
+    ppoll (nullptr, 0, &timeout, nullptr);
+
+    return 0;
+}
+#endif
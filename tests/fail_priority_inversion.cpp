@@ -0,0 +1,50 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <rtcheck.h>
+
+/** Lowers the scheduling priority of the calling thread below that of the main thread. */
+void lower_thread_priority()
+{
+   #if __linux__
+    // The nice value is per thread on linux so this only affects the calling thread
+    setpriority (PRIO_PROCESS, 0, 19);
+   #else
+    sched_param param { .sched_priority = sched_get_priority_min (SCHED_OTHER) };
+    pthread_setschedparam (pthread_self(), SCHED_OTHER, &param);
+   #endif
+}
+
+int main()
+{
+    using namespace std::chrono_literals;
+
+    std::mutex m;
+    std::atomic<bool> locked { false };
+
+    // A lower priority thread holds the lock whilst the real-time thread waits for it
+    std::thread t ([&]
+                   {
+                       lower_thread_priority();
+                       std::scoped_lock lock (m);
+                       locked = true;
+                       std::this_thread::sleep_for (200ms);
+                   });
+
+    while (! locked)
+        std::this_thread::yield();
+
+    {
+        rtc::realtime_context rc;
+        rtc::disable_checks_for_thread (rtc::check_flags::threads);
+
+        std::scoped_lock lock (m);
+    }
+
+    t.join();
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#include <sys/select.h>
+#include <rtcheck.h>
+
+int main()
+{
+    timespec timeout { 0, 1000 };
+
+    rtc::realtime_context rc;
+    pselect (0, nullptr, nullptr, nullptr, &timeout, nullptr);
+
+    return 0;
+}
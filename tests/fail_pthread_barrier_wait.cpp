@@ -0,0 +1,25 @@
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+#include <pthread.h>
+
+int main()
+{
+    pthread_barrier_t barrier;
+    pthread_barrier_init (&barrier, nullptr, 1);
+
+    {
+        rtc::realtime_context rc;
+        pthread_barrier_wait (&barrier);
+    }
+
+    pthread_barrier_destroy (&barrier);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,10 @@
+#include <sched.h>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+    sched_yield();
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#include <sys/select.h>
+#include <rtcheck.h>
+
+int main()
+{
+    timeval timeout { 0, 1 };
+
+    rtc::realtime_context rc;
+    select (0, nullptr, nullptr, nullptr, &timeout);
+
+    return 0;
+}
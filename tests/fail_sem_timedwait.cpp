@@ -0,0 +1,29 @@
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 1;
+}
+#else
+#include <semaphore.h>
+#include <time.h>
+
+int main()
+{
+    sem_t sem;
+    sem_init (&sem, 0, 1);
+
+    timespec deadline;
+    clock_gettime (CLOCK_REALTIME, &deadline);
+
+    {
+        rtc::realtime_context rc;
+        sem_timedwait (&sem, &deadline);
+    }
+
+    sem_destroy (&sem);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,17 @@
+#include <semaphore.h>
+#include <rtcheck.h>
+
+int main()
+{
+    sem_t sem;
+    sem_init (&sem, 0, 1);
+
+    {
+        rtc::realtime_context rc;
+        sem_wait (&sem);
+    }
+
+    sem_destroy (&sem);
+
+    return 0;
+}
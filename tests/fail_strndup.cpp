@@ -0,0 +1,11 @@
+#include <string.h>
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::realtime_context rc;
+
+    [[ maybe_unused ]] volatile auto res = strndup ("real-time", 4);
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <rtcheck.h>
+
+int main()
+{
+    rtc::enable_thread_preparation_check();
+
+    // prepare_realtime_thread hasn't been called
+    rtc::realtime_context rc;
+
+    return 0;
+}
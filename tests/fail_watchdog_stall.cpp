@@ -0,0 +1,22 @@
+#include <chrono>
+#include <rtcheck.h>
+
+int main()
+{
+    using namespace std::chrono_literals;
+
+    rtc::start_watchdog ({ .threshold = 50ms, .poll_interval = 5ms });
+
+    {
+        rtc::realtime_context rc;
+
+        // Spin without calling any intercepted functions
+        for (auto start = std::chrono::steady_clock::now();
+             std::chrono::steady_clock::now() - start < 2s;)
+        {}
+    }
+
+    rtc::stop_watchdog();
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+// A small library used by the dynamic loading tests
+#include <unistd.h>
+
+extern "C" int rtcheck_test_library_function()
+{
+    return 42;
+}
+
+// This library is linked with -z lazy so the first call to getppid goes through the dynamic linker
+extern "C" int rtcheck_test_library_lazy_call()
+{
+    return getppid() > 0 ? 1 : 0;
+}
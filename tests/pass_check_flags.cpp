@@ -0,0 +1,40 @@
+#include <cassert>
+#include <cstring>
+#include <rtcheck.h>
+
+// The indices of existing checks mustn't change as they're written to violation logs
+// and passed as raw masks to disable_checks_for_thread (uint64_t)
+static_assert (static_cast<uint64_t> (rtc::check_flags::malloc) == 1);
+static_assert (static_cast<uint64_t> (rtc::check_flags::pthread_create) == 1 << 9);
+static_assert (static_cast<uint64_t> (rtc::check_flags::syscall) == 1ull << 38);
+static_assert (static_cast<std::size_t> (rtc::check_id::unprepared_thread) == 57);
+
+static_assert ((rtc::check_flags::memory & rtc::check_flags::threads).none());
+static_assert ((rtc::check_flags::memory & rtc::check_flags::malloc) == rtc::check_flags::malloc);
+static_assert (! rtc::check_flags::files.intersects (rtc::check_flags::fcntl));
+static_assert (rtc::check_flags::sys == (rtc::check_flags::schedule | rtc::check_flags::context_switch | rtc::check_flags::syscall));
+static_assert ((rtc::check_flags::all() & rtc::check_flags::unprepared_thread).any());
+
+int main()
+{
+    assert (std::strcmp (rtc::get_check_name (rtc::check_id::pthread_mutex_lock), "pthread_mutex_lock") == 0);
+    assert (rtc::check_infos[static_cast<std::size_t> (rtc::check_id::memalign)].platform == rtc::check_platform::linux_only);
+
+    rtc::disable_checks_for_thread (rtc::check_flags::memory | rtc::check_flags::sleeping);
+    assert (! rtc::is_check_enabled_for_thread (rtc::check_flags::malloc));
+    assert (! rtc::is_check_enabled_for_thread (rtc::check_flags::usleep));
+    assert (rtc::is_check_enabled_for_thread (rtc::check_flags::pthread_join));
+
+    // The older mask overload still refers to the same checks
+    rtc::disable_checks_for_thread (static_cast<uint64_t> (rtc::check_flags::pthread_create | rtc::check_flags::pthread_join));
+    assert (rtc::is_check_enabled_for_thread (rtc::check_flags::malloc));
+    assert (! rtc::is_check_enabled_for_thread (rtc::check_flags::pthread_join));
+
+    {
+        rtc::realtime_context rc;
+        rtc::disable_checks_for_thread (rtc::check_flags::memory);
+        free (malloc (16));
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+[[gnu::noinline]] void allocate_at_one_site()
+{
+    [[ maybe_unused ]] volatile auto res = malloc (16);
+    free (res);
+}
+
+[[gnu::noinline]] void new_at_site_a()
+{
+    delete new int (1);
+    asm volatile ("");
+}
+
+[[gnu::noinline]] void new_at_site_b()
+{
+    delete new int (2);
+    asm volatile ("");
+}
+
+int main()
+{
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+    rtc::set_error_mode (rtc::error_mode::callback);
+    rtc::set_check_policy (rtc::check_flags::free, rtc::check_policy::ignore);
+
+    auto get_count = [] (rtc::check_flags check) { return rtc::get_violation_stats().total.get (check); };
+
+    auto allocate_in_realtime_context = []
+    {
+        rtc::realtime_context rc;
+        allocate_at_one_site();
+    };
+
+    // Ignored checks aren't reported or counted
+    rtc::set_check_policy (rtc::check_flags::malloc, rtc::check_policy::ignore);
+    allocate_in_realtime_context();
+    assert (recorder.num_calls == 0);
+    assert (get_count (rtc::check_flags::malloc) == 0);
+
+    // Counted checks are only added to the stats
+    rtc::set_check_policy (rtc::check_flags::malloc, rtc::check_policy::count);
+    allocate_in_realtime_context();
+    assert (recorder.num_calls == 0);
+    assert (get_count (rtc::check_flags::malloc) == 1);
+
+    // Each call site is only reported once
+    rtc::set_check_policy (rtc::check_flags::malloc, rtc::check_policy::log_once);
+
+    for (int i = 0; i < 3; ++i)
+        allocate_in_realtime_context();
+
+    assert (recorder.num_calls == 1);
+    assert (get_count (rtc::check_flags::malloc) == 4);
+
+    {
+        rtc::realtime_context rc;
+        [[ maybe_unused ]] volatile auto res = malloc (16);
+        free (res);
+    }
+
+    assert (recorder.num_calls == 2);
+
+    // Sites are the callers of new, not rtcheck's operator new
+    rtc::set_check_policy (rtc::check_flags::operator_new, rtc::check_policy::log_once);
+    rtc::set_check_policy (rtc::check_flags::operator_delete, rtc::check_policy::ignore);
+
+    {
+        rtc::realtime_context rc;
+
+        for (int i = 0; i < 2; ++i)
+        {
+            new_at_site_a();
+            new_at_site_b();
+        }
+    }
+
+    assert (recorder.num_calls == 4);
+
+    // Logging continues even when the error mode would exit
+    rtc::set_error_mode (rtc::error_mode::exit);
+    rtc::set_check_policy (rtc::check_flags::memory, rtc::check_policy::log);
+
+    {
+        rtc::realtime_context rc;
+        [[ maybe_unused ]] volatile auto res = calloc (1, 16);
+        free (res);
+    }
+
+    assert (get_count (rtc::check_flags::calloc) == 1);
+    assert (get_count (rtc::check_flags::free) == 1);
+
+    rtc::reset_check_policies();
+    assert (rtc::get_check_policy (rtc::check_id::malloc) == rtc::check_policy::default_mode);
+
+    // Policies can be loaded from a file, skipping invalid rules
+    char path[] = "/tmp/rtcheck_policies_XXXXXX";
+    const auto fd = mkstemp (path);
+    assert (fd >= 0);
+    close (fd);
+
+    if (auto file = std::fopen (path, "w"))
+    {
+        std::fputs ("# Fail on mappings, count locks\n"
+                    "mmap|munmap: exit\n"
+                    "threads: count\n"
+                    "unknown_check: exit\n"
+                    "malloc: sometimes\n", file);
+        std::fclose (file);
+    }
+
+    assert (rtc::load_check_policies (path));
+    std::remove (path);
+
+    assert (rtc::get_check_policy (rtc::check_id::mmap) == rtc::check_policy::exit);
+    assert (rtc::get_check_policy (rtc::check_id::munmap) == rtc::check_policy::exit);
+    assert (rtc::get_check_policy (rtc::check_id::pthread_mutex_lock) == rtc::check_policy::count);
+    assert (rtc::get_check_policy (rtc::check_id::malloc) == rtc::check_policy::default_mode);
+    assert (! rtc::load_check_policies ("/nonexistent/rtcheck_policies"));
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <cassert>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <rtcheck.h>
+
+using namespace std::chrono_literals;
+
+void spin_for (std::chrono::nanoseconds duration)
+{
+    const auto end = std::chrono::steady_clock::now() + duration;
+
+    while (std::chrono::steady_clock::now() < end)
+        ;
+}
+
+void run_cycles (int num_cycles, std::chrono::nanoseconds period)
+{
+    auto next_start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < num_cycles; ++i)
+    {
+        std::this_thread::sleep_until (next_start);
+        next_start += period;
+
+        rtc::cycle_scope cycle (period);
+        rtc::realtime_context rc;
+
+        // Three consecutive overruns
+        if (i >= 3 && i < 6)
+            spin_for (period * 2);
+    }
+}
+
+int main()
+{
+    assert (rtc::get_cycle_stats().empty());
+
+    run_cycles (20, 2ms);
+
+    {
+        const auto stats = rtc::get_cycle_stats_for_thread();
+        assert (stats.num_cycles == 20);
+        assert (stats.num_overruns == 3);
+        assert (stats.current_overrun_streak == 0);
+        assert (stats.longest_overrun_streak == 3);
+        assert (stats.overrun_streaks[2] == 1);
+        assert (stats.period == 2ms);
+
+        // The overruns are at least 200% and the first cycle has no jitter
+        assert (stats.load.back() == 3);
+        assert (std::accumulate (stats.load.begin(), stats.load.end(), uint64_t (0)) == 20);
+        assert (std::accumulate (stats.jitter.begin(), stats.jitter.end(), uint64_t (0)) == 19);
+        assert (stats.max_jitter >= 2ms);
+    }
+
+    {
+        std::thread t ([] { run_cycles (5, 1ms); assert (rtc::get_cycle_stats().size() == 2); });
+        t.join();
+    }
+
+    // Threads that have exited aren't listed
+    assert (rtc::get_cycle_stats().size() == 1);
+
+    rtc::reset_cycle_stats();
+    assert (rtc::get_cycle_stats().empty());
+    assert (rtc::get_cycle_stats_for_thread().num_cycles == 0);
+
+    run_cycles (1, 1ms);
+    assert (rtc::get_cycle_stats_for_thread().num_cycles == 1);
+
+    return 0;
+}
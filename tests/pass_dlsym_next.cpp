@@ -0,0 +1,30 @@
+#include <cassert>
+#include <cstdlib>
+#include <rtcheck.h>
+
+#if ! __APPLE__
+ #include <dlfcn.h>
+#endif
+
+int main()
+{
+   #if ! __APPLE__
+    // rtcheck is the next object after this one that defines malloc, so
+    // RTLD_NEXT should find its interceptor rather than the one in libc
+    auto next_malloc = dlsym (RTLD_NEXT, "malloc");
+    assert (next_malloc != nullptr);
+    assert (next_malloc == reinterpret_cast<void*> (&malloc));
+
+    assert (dlsym (RTLD_NEXT, "rtcheck_undefined_function") == nullptr);
+
+    // Lookups from a handle are unchanged
+    auto handle = dlopen (RTCHECK_TEST_LIBRARY_PATH, RTLD_NOW);
+    assert (handle != nullptr);
+
+    auto function = reinterpret_cast<int (*)()> (dlsym (handle, "rtcheck_test_library_function"));
+    assert (function != nullptr && function() == 42);
+    dlclose (handle);
+   #endif
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+int main()
+{
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+
+    // Global callback mode
+    {
+        rtc::set_error_mode (rtc::error_mode::callback);
+
+        rtc::realtime_context rc;
+        [[ maybe_unused ]] volatile auto res = malloc (1024);
+    }
+
+    assert (recorder.num_calls == 1);
+    assert (recorder.last_check == rtc::check_flags::malloc);
+    assert (recorder.last_size == 1024);
+    assert (recorder.last_num_frames > 0);
+    assert (recorder.last_message_contains (recorder.last_function));
+
+    // Per-thread callback mode overrides the global exit mode
+    rtc::set_error_mode (rtc::error_mode::exit);
+
+    std::thread t ([]
+                   {
+                       rtc::set_error_mode_for_thread (rtc::error_mode::callback);
+                       assert (rtc::get_error_mode_for_thread() == rtc::error_mode::callback);
+
+                       rtc::realtime_context rc;
+                       [[ maybe_unused ]] volatile auto res = calloc (16, 4);
+                   });
+    t.join();
+
+    assert (recorder.num_calls == 2);
+    assert (recorder.last_check == rtc::check_flags::calloc);
+    assert (recorder.last_size == 64);
+
+    // Other threads still use the global mode
+    assert (rtc::get_error_mode_for_thread() == rtc::error_mode::exit);
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <cassert>
+#include <csignal>
+#include <memory>
+#include <rtcheck.h>
+
+volatile std::sig_atomic_t num_traps = 0;
+
+int main()
+{
+    std::signal (SIGTRAP, [] (int) { num_traps = num_traps + 1; });
+
+    rtc::set_error_mode_for_thread (rtc::error_mode::trap);
+
+    {
+        rtc::realtime_context rc;
+        [[ maybe_unused ]] volatile auto res = malloc (1024);
+    }
+
+    assert (num_traps == 1);
+
+    rtc::reset_error_mode_for_thread();
+    assert (rtc::get_error_mode_for_thread() == rtc::get_error_mode());
+
+    return 0;
+}
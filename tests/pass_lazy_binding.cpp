@@ -0,0 +1,53 @@
+#include <cassert>
+#include <cstring>
+#include <dlfcn.h>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+int main()
+{
+   #if ! __APPLE__
+    rtc::set_error_mode (rtc::error_mode::callback);
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+
+    auto handle = dlopen (RTCHECK_TEST_LIBRARY_PATH, RTLD_LAZY);
+    assert (handle != nullptr);
+
+    auto function = reinterpret_cast<int (*)()> (dlsym (handle, "rtcheck_test_library_function"));
+    auto lazy_call = reinterpret_cast<int (*)()> (dlsym (handle, "rtcheck_test_library_lazy_call"));
+    assert (function != nullptr && lazy_call != nullptr);
+
+    assert (rtc::enable_lazy_binding_check());
+
+    // Calls that don't need resolving aren't reported
+    {
+        rtc::realtime_context rc;
+        assert (function() == 42);
+    }
+
+    assert (recorder.num_calls == 0);
+
+    // The first call through the PLT is
+    {
+        rtc::realtime_context rc;
+        assert (lazy_call() == 1);
+    }
+
+    assert (recorder.num_calls == 1);
+    assert (recorder.last_check == rtc::check_flags::lazy_binding);
+    assert (std::strcmp (recorder.last_function, "getppid") == 0);
+    assert (rtc::get_violation_stats().total.get (rtc::check_flags::lazy_binding) == 1);
+
+    // But only the first
+    {
+        rtc::realtime_context rc;
+        assert (lazy_call() == 1);
+    }
+
+    assert (recorder.num_calls == 1);
+    rtc::disable_lazy_binding_check();
+   #endif
+
+    return 0;
+}
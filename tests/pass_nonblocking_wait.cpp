@@ -0,0 +1,49 @@
+#include <cassert>
+#include <poll.h>
+#include <sys/select.h>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+int main()
+{
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+    rtc::set_error_mode (rtc::error_mode::callback);
+
+    rtc::realtime_context rc;
+
+    // A zero timeout is reported separately to a wait that can block
+    poll (nullptr, 0, 0);
+    assert (recorder.num_calls == 1);
+    assert (recorder.last_check == rtc::check_flags::nonblocking_wait);
+    assert (recorder.last_message_contains ("with a zero timeout"));
+
+    poll (nullptr, 0, 1);
+    assert (recorder.num_calls == 2);
+    assert (recorder.last_check == rtc::check_flags::poll);
+    assert (! recorder.last_message_contains ("with a zero timeout"));
+
+    timeval zero {};
+    select (0, nullptr, nullptr, nullptr, &zero);
+    assert (recorder.num_calls == 3);
+    assert (recorder.last_check == rtc::check_flags::nonblocking_wait);
+
+    // Non-blocking waits can be disabled on their own
+    rtc::disable_checks_for_thread (rtc::check_flags::nonblocking_wait);
+    poll (nullptr, 0, 0);
+    assert (recorder.num_calls == 3);
+
+    poll (nullptr, 0, 1);
+    assert (recorder.num_calls == 4);
+
+    // Disabling a wait also disables its non-blocking form
+    rtc::disable_checks_for_thread (rtc::check_flags::poll);
+    poll (nullptr, 0, 0);
+    assert (recorder.num_calls == 4);
+
+    rtc::disable_checks_for_thread (rtc::check_flags {});
+    assert (rtc::get_violation_stats_for_thread().get (rtc::check_flags::nonblocking_wait) == 2);
+    assert (rtc::get_violation_stats_for_thread().get (rtc::check_flags::waiting) == 4);
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+#include <rtcheck.h>
+
+struct alignas (128) aligned_block
+{
+    float data[32];
+};
+
+int main()
+{
+    // Allocations outside of a real-time context must behave as normal
+    auto block = std::make_unique<aligned_block[]> (8);
+    assert ((reinterpret_cast<std::uintptr_t> (block.get()) % 128) == 0);
+
+    std::vector<int> vec (1024, 42);
+    assert (vec[1023] == 42);
+
+    auto nothrow = new (std::nothrow) int[16];
+    assert (nothrow != nullptr);
+    delete[] nothrow;
+
+    {
+        rtc::realtime_context rc;
+        rtc::disable_checks_for_thread (rtc::check_flags::memory);
+
+        auto res = new aligned_block;
+        delete res;
+    }
+
+    return 0;
+}
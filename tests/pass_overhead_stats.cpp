@@ -0,0 +1,78 @@
+#include <cassert>
+#include <cstdlib>
+#include <thread>
+#include <rtcheck.h>
+
+int num_violations = 0;
+
+void allocate_without_violations (int num_allocations)
+{
+    rtc::realtime_context rc;
+    rtc::non_realtime_context nrc;
+
+    for (int i = 0; i < num_allocations; ++i)
+        free (malloc (16));
+}
+
+int main()
+{
+    rtc::set_violation_handler ([] (const rtc::violation_record&, void*) { ++num_violations; });
+    rtc::set_error_mode (rtc::error_mode::callback);
+
+    // Nothing is counted until accounting is enabled
+    allocate_without_violations (10);
+    assert (rtc::get_overhead_stats_for_thread().num_hook_calls == 0);
+
+    rtc::enable_overhead_accounting();
+    allocate_without_violations (100);
+
+    {
+        const auto counts = rtc::get_overhead_stats_for_thread();
+        assert (counts.num_hook_calls >= 200);
+        assert (counts.hook_time.count() > 0);
+        assert (counts.max_hook_time <= counts.hook_time);
+        assert (counts.realtime_time >= counts.hook_time);
+        assert (counts.stack_capture_time.count() == 0);
+        assert (counts.reporting_time.count() == 0);
+        assert (counts.get_realtime_share() > 0.0 && counts.get_realtime_share() <= 1.0);
+    }
+
+    // Calls outside of a realtime_context aren't counted
+    {
+        const auto before = rtc::get_overhead_stats_for_thread().num_hook_calls;
+        free (malloc (16));
+        assert (rtc::get_overhead_stats_for_thread().num_hook_calls == before);
+    }
+
+    // Violations add the stack capture and reporting
+    {
+        rtc::realtime_context rc;
+        [[ maybe_unused ]] volatile auto ptr = malloc (16);
+        free (ptr);
+    }
+
+    assert (num_violations == 2);
+
+    {
+        const auto counts = rtc::get_overhead_stats_for_thread();
+        assert (counts.stack_capture_time.count() > 0);
+        assert (counts.reporting_time.count() > 0);
+        assert (counts.hook_time >= counts.stack_capture_time + counts.reporting_time);
+    }
+
+    // Threads that have exited are included in the total
+    const auto this_thread_calls = rtc::get_overhead_stats_for_thread().num_hook_calls;
+    std::thread ([] { allocate_without_violations (50); }).join();
+
+    {
+        const auto stats = rtc::get_overhead_stats();
+        assert (stats.total.num_hook_calls >= this_thread_calls + 100);
+        assert (stats.threads.size() == 1);
+    }
+
+    rtc::disable_overhead_accounting();
+    allocate_without_violations (10);
+    assert (rtc::get_overhead_stats_for_thread().num_hook_calls == this_thread_calls);
+
+    return 0;
+}
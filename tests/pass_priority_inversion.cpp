@@ -0,0 +1,109 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+/** Lowers the scheduling priority of the calling thread below that of the main thread. */
+void lower_thread_priority()
+{
+   #if __linux__
+    // The nice value is per thread on linux so this only affects the calling thread
+    setpriority (PRIO_PROCESS, 0, 19);
+   #else
+    sched_param param { .sched_priority = sched_get_priority_min (SCHED_OTHER) };
+    pthread_setschedparam (pthread_self(), SCHED_OTHER, &param);
+   #endif
+}
+
+int main()
+{
+    using namespace std::chrono_literals;
+
+    rtc::set_error_mode (rtc::error_mode::callback);
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+
+    std::mutex m;
+
+    auto lock_in_realtime_context = [&m]
+    {
+        rtc::realtime_context rc;
+        rtc::disable_checks_for_thread (rtc::check_flags::threads);
+
+        std::scoped_lock lock (m);
+    };
+
+    // An uncontended lock isn't a priority inversion
+    lock_in_realtime_context();
+    assert (recorder.num_calls == 0);
+
+    // Neither is waiting for a lock held by a thread with the same priority
+    std::atomic<bool> locked { false };
+
+    std::thread t0 ([&]
+                    {
+                        std::scoped_lock lock (m);
+                        locked = true;
+                        std::this_thread::sleep_for (50ms);
+                    });
+
+    while (! locked)
+        std::this_thread::yield();
+
+    lock_in_realtime_context();
+    t0.join();
+    assert (recorder.num_calls == 0);
+
+    // Waiting for a lock held by a lower priority SCHED_OTHER thread is
+    locked = false;
+
+    std::thread t ([&]
+                   {
+                       lower_thread_priority();
+                       std::scoped_lock lock (m);
+                       locked = true;
+                       std::this_thread::sleep_for (100ms);
+                   });
+
+    while (! locked)
+        std::this_thread::yield();
+
+    lock_in_realtime_context();
+    t.join();
+
+    assert (recorder.num_calls == 1);
+    assert (recorder.last_check == rtc::check_flags::priority_inversion);
+    assert (recorder.last_message_contains ("SCHED_OTHER"));
+    assert (rtc::get_violation_stats().total.get (rtc::check_flags::priority_inversion) == 1);
+
+    // The check can be disabled independently of the lock checks
+    locked = false;
+
+    std::thread t2 ([&]
+                    {
+                        lower_thread_priority();
+                        std::scoped_lock lock (m);
+                        locked = true;
+                        std::this_thread::sleep_for (50ms);
+                    });
+
+    while (! locked)
+        std::this_thread::yield();
+
+    {
+        rtc::realtime_context rc;
+        rtc::disable_checks_for_thread (rtc::check_flags::threads | rtc::check_flags::priority_inversion);
+
+        std::scoped_lock lock (m);
+    }
+
+    t2.join();
+    assert (recorder.num_calls == 1);
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <cassert>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <rtcheck.h>
+
+__attribute__((noinline)) void realtime_work (std::chrono::milliseconds duration)
+{
+    for (auto start = std::chrono::steady_clock::now();
+         std::chrono::steady_clock::now() - start < duration;)
+    {}
+}
+
+__attribute__((noinline)) void non_realtime_work (std::chrono::milliseconds duration)
+{
+    for (auto start = std::chrono::steady_clock::now();
+         std::chrono::steady_clock::now() - start < duration;)
+    {}
+}
+
+int main()
+{
+   #if __linux__
+    using namespace std::chrono_literals;
+
+    assert (rtc::start_profiler ({ .interval = 1ms }));
+    assert (! rtc::start_profiler());
+
+    std::thread t ([]
+                   {
+                       non_realtime_work (200ms);
+
+                       rtc::realtime_context rc;
+                       realtime_work (200ms);
+                   });
+    t.join();
+
+    rtc::stop_profiler();
+
+    std::ostringstream folded;
+    rtc::write_folded_stacks (folded);
+    const auto output = folded.str();
+
+    // Only the time spent in the real-time context should be sampled
+    assert (output.find ("realtime_work") != std::string::npos);
+    assert (output.find ("non_realtime_work") == std::string::npos);
+   #endif
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+int main()
+{
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+    rtc::set_error_mode (rtc::error_mode::callback);
+
+    rtc::realtime_group group;
+    std::atomic<int> phase { 0 }, num_done { 0 };
+    constexpr int num_workers = 3;
+
+    auto wait_for_phase = [&] (int p) { while (phase.load() != p) std::this_thread::yield(); };
+
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < num_workers; ++i)
+    {
+        workers.emplace_back ([&]
+                              {
+                                  group.join();
+                                  free (malloc (1024));     // Not in a cycle yet
+                                  ++num_done;
+
+                                  wait_for_phase (1);
+                                  assert (rtc::is_real_time_context());
+                                  [[ maybe_unused ]] volatile auto res = malloc (1024);
+
+                                  {
+                                      rtc::non_realtime_context nrc;
+                                      assert (! rtc::is_real_time_context());
+                                      free (res);
+                                  }
+
+                                  assert (rtc::is_real_time_context());
+                                  ++num_done;
+
+                                  {
+                                      // Yielding is a violation during the cycle so wait outside of it
+                                      rtc::non_realtime_context nrc;
+                                      wait_for_phase (2);
+                                  }
+
+                                  assert (! rtc::is_real_time_context());
+                                  group.leave();
+                              });
+    }
+
+    while (num_done.load() != num_workers)
+        std::this_thread::yield();
+
+    group.begin_cycle();
+    phase = 1;
+
+    while (num_done.load() != 2 * num_workers)
+        std::this_thread::yield();
+
+    group.end_cycle();
+    phase = 2;
+
+    for (auto& t : workers)
+        t.join();
+
+    // Only the malloc in each cycle is reported
+    assert (recorder.num_calls.load() == num_workers);
+
+    return 0;
+}
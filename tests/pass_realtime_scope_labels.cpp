@@ -0,0 +1,84 @@
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <rtcheck.h>
+
+namespace
+{
+    const char* last_scope_label = nullptr;
+    int num_violations = 0;
+
+    void record_violation (const rtc::violation_record& record, void*)
+    {
+        last_scope_label = record.scope_label;
+        ++num_violations;
+    }
+
+    uint64_t get_scope_count (const char* label)
+    {
+        for (auto& scope : rtc::get_violation_stats().scopes)
+            if (std::strcmp (scope.label, label) == 0)
+                return scope.count;
+
+        return 0;
+    }
+}
+
+int main()
+{
+    rtc::set_violation_handler (record_violation, nullptr);
+    rtc::set_error_mode (rtc::error_mode::callback);
+
+    {
+        rtc::realtime_context graph ("graph");
+
+        {
+            rtc::realtime_context node ("reverb");
+            assert (rtc::is_real_time_context());
+
+            free (malloc (16));
+            assert (last_scope_label != nullptr && std::strcmp (last_scope_label, "reverb") == 0);
+        }
+
+        // The outer scope is still active once the nested one exits
+        assert (rtc::is_real_time_context());
+
+        free (malloc (16));
+        assert (std::strcmp (last_scope_label, "graph") == 0);
+
+        {
+            // An unlabelled scope is attributed to the enclosing label
+            rtc::realtime_context unlabelled;
+            free (malloc (16));
+            assert (std::strcmp (last_scope_label, "graph") == 0);
+        }
+
+        {
+            rtc::non_realtime_context nrc;
+            assert (! rtc::is_real_time_context());
+
+            {
+                // A scope inside a non_realtime_context is real-time again until it exits
+                rtc::realtime_context inner ("inner");
+                assert (rtc::is_real_time_context());
+            }
+
+            assert (! rtc::is_real_time_context());
+            free (malloc (16));
+        }
+
+        assert (rtc::is_real_time_context());
+    }
+
+    assert (! rtc::is_real_time_context());
+    assert (num_violations == 6);
+
+    assert (get_scope_count ("reverb") == 2);
+    assert (get_scope_count ("graph") == 4);
+    assert (get_scope_count ("inner") == 0);
+
+    rtc::reset_violation_stats();
+    assert (rtc::get_violation_stats().scopes.empty());
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+int main()
+{
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+    rtc::set_error_mode (rtc::error_mode::callback);
+
+    rtc::realtime_token job_token ("mix_node");
+    rtc::realtime_token token (std::move (job_token));
+    assert (std::strcmp (token.label, "mix_node") == 0);
+
+    // The job runs on a worker thread which isn't real-time itself
+    std::thread worker ([&]
+                        {
+                            assert (! rtc::is_real_time_context());
+
+                            {
+                                rtc::realtime_token_scope scope (token);
+                                assert (rtc::is_real_time_context());
+                                [[ maybe_unused ]] volatile auto res = malloc (1024);
+                            }
+
+                            assert (! rtc::is_real_time_context());
+                            free (malloc (1024));
+                        });
+    worker.join();
+
+    assert (recorder.num_calls == 1);
+    assert (recorder.last_token == &token);
+    assert (recorder.last_message_contains ("mix_node"));
+
+    // Tokens can be activated on a thread that is already real-time
+    {
+        rtc::realtime_context rc;
+
+        {
+            rtc::realtime_token_scope scope (token);
+        }
+
+        assert (rtc::is_real_time_context());
+    }
+
+    return 0;
+}
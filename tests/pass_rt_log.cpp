@@ -0,0 +1,73 @@
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <rtcheck.h>
+
+std::string read_all (int fd)
+{
+    std::string text;
+    char buffer[4096];
+
+    for (ssize_t n; (n = read (fd, buffer, sizeof (buffer))) > 0;)
+        text.append (buffer, static_cast<std::size_t> (n));
+
+    return text;
+}
+
+int main()
+{
+    int fds[2];
+    assert (pipe (fds) == 0);
+
+    // Logging before the queues exist is dropped rather than allocating
+    {
+        rtc::realtime_context rc;
+        rtc::rt_log ("too early");
+    }
+
+    assert (rtc::start_rt_log ({ .fd = fds[1] }));
+    assert (! rtc::start_rt_log ({ .fd = fds[1] }));
+
+    // The default error mode exits on a violation, so any intercepted call fails the test
+    {
+        rtc::realtime_context rc;
+        rtc::rt_log ("first %d %s %.2f", 42, "text", 1.5);
+        rtc::rt_log ("second");
+    }
+
+    std::thread t ([]
+    {
+        rtc::realtime_context rc;
+        rtc::rt_log ("from another thread");
+    });
+    t.join();
+
+    rtc::stop_rt_log();
+
+    // Without the drain thread the queue fills and later messages are dropped
+    {
+        rtc::realtime_context rc;
+
+        for (int i = 0; i < 100; ++i)
+            rtc::rt_log ("message %d", i);
+    }
+
+    rtc::flush_rt_log();
+    close (fds[1]);
+
+    const auto text = read_all (fds[0]);
+    const auto first = text.find ("] first 42 text 1.50\n");
+    const auto second = text.find ("] second\n");
+
+    assert (text.find ("too early") == std::string::npos);
+    assert (first != std::string::npos && second != std::string::npos && first < second);
+    assert (text.find ("] from another thread\n") != std::string::npos);
+    assert (text.find ("message 63\n") != std::string::npos);
+    assert (text.find ("message 64\n") == std::string::npos);
+    assert (text.find ("rt_log: 1 messages dropped") != std::string::npos);
+    assert (text.find ("rt_log: 36 messages dropped") != std::string::npos);
+
+    return 0;
+}
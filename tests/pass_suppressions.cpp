@@ -0,0 +1,50 @@
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <rtcheck.h>
+
+namespace audited
+{
+    [[gnu::noinline]] void allocate()
+    {
+        free (malloc (1024));
+        asm volatile ("");
+    }
+}
+
+[[gnu::noinline]] void allocate()
+{
+    free (malloc (1024));
+    asm volatile ("");
+}
+
+int main()
+{
+   #if __linux__
+    rtc::set_error_mode (rtc::error_mode::cont);
+
+    constexpr auto path = "pass_suppressions.supp";
+
+    if (auto file = std::fopen (path, "w"))
+    {
+        std::fputs ("# Only the allocation is suppressed\n"
+                    "malloc:audited::allocate\n", file);
+        std::fclose (file);
+    }
+
+    assert (rtc::load_suppressions (path));
+    std::remove (path);
+
+    {
+        rtc::realtime_context rc;
+        audited::allocate();
+        allocate();
+    }
+
+    const auto counts = rtc::get_violation_stats_for_thread();
+    assert (counts.get (rtc::check_flags::malloc) == 1);
+    assert (counts.get (rtc::check_flags::free) == 2);
+   #endif
+
+    return 0;
+}
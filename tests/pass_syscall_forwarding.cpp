@@ -0,0 +1,70 @@
+#include <rtcheck.h>
+
+#if __APPLE__
+int main()
+{
+    return 0;
+}
+#else
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "violation_recorder.h"
+
+int main()
+{
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+    rtc::set_error_mode (rtc::error_mode::callback);
+
+    const auto tid = gettid();
+    int fds[2];
+    assert (pipe (fds) == 0);
+
+    rtc::realtime_context rc;
+
+    // Results and all six arguments are passed through
+    assert (syscall (SYS_gettid) == tid);
+    assert (recorder.last_check == rtc::check_flags::syscall);
+
+    assert (syscall (SYS_write, fds[1], "rtcheck", 7) == 7);
+
+    auto page = reinterpret_cast<char*> (syscall (SYS_mmap, nullptr, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    assert (page != MAP_FAILED);
+    page[4095] = 1;
+    assert (syscall (SYS_munmap, page, 4096) == 0);
+    assert (recorder.num_calls == 4);
+
+    // Waits are reported as futex with the operation
+    int word = 0;
+    assert (syscall (SYS_futex, &word, FUTEX_WAIT_PRIVATE, 1, nullptr, nullptr, 0) == -1 && errno == EAGAIN);
+    assert (recorder.num_calls == 5);
+    assert (recorder.last_check == rtc::check_flags::futex);
+    assert (std::strcmp (recorder.last_function, "futex (FUTEX_WAIT)") == 0);
+
+    // Wakes can't block so are reported as futex_wake
+    assert (syscall (SYS_futex, &word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0) == 0);
+    assert (recorder.num_calls == 6);
+    assert (recorder.last_check == rtc::check_flags::futex_wake);
+
+    // Wakes can be allowed whilst still reporting waits
+    rtc::disable_checks_for_thread (rtc::check_flags::futex_wake);
+    syscall (SYS_futex, &word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    assert (recorder.num_calls == 6);
+
+    syscall (SYS_futex, &word, FUTEX_WAIT_PRIVATE, 1, nullptr, nullptr, 0);
+    assert (recorder.num_calls == 7);
+
+    // Disabling futex disables both
+    rtc::disable_checks_for_thread (rtc::check_flags::futex);
+    syscall (SYS_futex, &word, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    syscall (SYS_futex, &word, FUTEX_WAIT_PRIVATE, 1, nullptr, nullptr, 0);
+    assert (recorder.num_calls == 7);
+
+    return 0;
+}
+#endif
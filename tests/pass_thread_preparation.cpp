@@ -0,0 +1,74 @@
+#include <cassert>
+#include <thread>
+#include <sys/mman.h>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+int main()
+{
+    rtc::set_error_mode (rtc::error_mode::callback);
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+
+    // This needs privileges so may not be possible
+    const bool is_locked = mlockall (MCL_CURRENT | MCL_FUTURE) == 0;
+
+    rtc::enable_thread_preparation_check();
+
+    std::thread t ([is_locked, &recorder]
+                   {
+                       const bool is_prepared = rtc::prepare_realtime_thread (128 * 1024, 1024 * 1024);
+                       assert (is_prepared == is_locked);
+
+                       {
+                           rtc::realtime_context rc;
+                       }
+
+                       if (is_locked)
+                       {
+                           assert (recorder.num_calls == 0);
+                       }
+                       else
+                       {
+                           assert (recorder.num_calls == 1);
+                           assert (recorder.last_check == rtc::check_flags::unprepared_thread);
+                           assert (recorder.last_message_contains ("mlockall"));
+                           assert (! recorder.last_message_contains ("prefaulted"));
+                       }
+
+                       // Threads are only checked once
+                       {
+                           rtc::realtime_context rc;
+                       }
+
+                       assert (recorder.num_calls == (is_locked ? 0 : 1));
+                   });
+    t.join();
+
+    // A thread that isn't prepared is always reported
+    std::thread t2 ([]
+                    {
+                        rtc::realtime_context rc;
+                    });
+    t2.join();
+
+    assert (recorder.last_message_contains ("prefaulted"));
+
+    // Enabling the check again checks every thread again
+    std::thread t3 ([&recorder]
+                    {
+                        const auto num_calls = recorder.num_calls.load();
+
+                        for (int i = 0; i < 2; ++i)
+                        {
+                            rtc::enable_thread_preparation_check();
+                            rtc::realtime_context rc;
+                        }
+
+                        assert (recorder.num_calls == num_calls + 2);
+                    });
+    t3.join();
+    rtc::disable_thread_preparation_check();
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <cassert>
+#include <cstdlib>
+#include <rtcheck.h>
+
+[[gnu::noinline]] void trusted_allocate()
+{
+    free (malloc (1024));
+    asm volatile ("");
+}
+
+[[gnu::noinline]] void untrusted_allocate()
+{
+    free (malloc (1024));
+    asm volatile ("");
+}
+
+[[gnu::noinline]] void trusted_new()
+{
+    delete new int (1);
+    delete[] new char[64];
+    asm volatile ("");
+}
+
+int main()
+{
+    rtc::set_error_mode (rtc::error_mode::cont);
+
+   #if __linux__
+    assert (rtc::trust_function (reinterpret_cast<const void*> (&trusted_allocate)));
+
+    {
+        rtc::realtime_context rc;
+        trusted_allocate();
+        untrusted_allocate();
+    }
+
+    {
+        const auto counts = rtc::get_violation_stats_for_thread();
+        assert (counts.get (rtc::check_flags::malloc) == 1);
+        assert (counts.get (rtc::check_flags::free) == 1);
+    }
+
+    // The global operator new and delete see the caller of new and delete
+    assert (rtc::trust_function (reinterpret_cast<const void*> (&trusted_new)));
+
+    {
+        rtc::realtime_context rc;
+        trusted_new();
+    }
+
+    {
+        const auto counts = rtc::get_violation_stats_for_thread();
+        assert (counts.get (rtc::check_flags::operator_new) == 0);
+        assert (counts.get (rtc::check_flags::operator_delete) == 0);
+    }
+
+    // Trusting the executable covers everything it calls directly
+    rtc::trust_module ("pass_trusted_caller");
+
+    {
+        rtc::realtime_context rc;
+        untrusted_allocate();
+    }
+
+    assert (rtc::get_violation_stats_for_thread().get (rtc::check_flags::memory) == 2);
+   #endif
+
+    return 0;
+}
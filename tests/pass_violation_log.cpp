@@ -0,0 +1,81 @@
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <rtcheck.h>
+
+// Read by the rtcheck_report test
+constexpr auto log_path = "pass_violation_log.log";
+
+int main()
+{
+    rtc::set_error_mode (rtc::error_mode::cont);
+
+    std::remove (log_path);
+    assert (rtc::set_violation_log_file (log_path));
+
+    {
+        rtc::realtime_context rc;
+
+        for (int i = 0; i < 3; ++i)
+            free (malloc (1024));
+    }
+
+    // Closes the log
+    assert (rtc::set_violation_log_file (nullptr));
+
+    std::ifstream log (log_path);
+    std::string line;
+    int num_modules = 0, num_violations = 0, num_costs = 0;
+
+    assert (std::getline (log, line) && line.starts_with ("rtcheck-log 1 "));
+
+    while (std::getline (log, line))
+    {
+        if (line.starts_with ("module "))
+            ++num_modules;
+        else if (line.starts_with ("violation "))
+            ++num_violations;
+        else if (line.starts_with ("cost "))
+            ++num_costs;
+    }
+
+   #if __linux__
+    assert (num_modules > 0);
+   #endif
+    assert (num_violations == 6);
+    assert (num_costs == 6);
+
+    // Closed logs aren't written to and the log can be opened again
+    const auto closed_size = std::filesystem::file_size (log_path);
+    constexpr auto reopened_path = "pass_violation_log_reopened.log";
+    std::remove (reopened_path);
+
+    {
+        rtc::realtime_context rc;
+        free (malloc (1024));
+    }
+
+    assert (std::filesystem::file_size (log_path) == closed_size);
+    assert (rtc::set_violation_log_file (reopened_path));
+
+    {
+        rtc::realtime_context rc;
+        free (malloc (1024));
+    }
+
+    assert (rtc::set_violation_log_file (nullptr));
+
+    std::ifstream reopened_log (reopened_path);
+    num_violations = 0;
+
+    while (std::getline (reopened_log, line))
+        if (line.starts_with ("violation "))
+            ++num_violations;
+
+    assert (num_violations == 2);
+    std::remove (reopened_path);
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <rtcheck.h>
+
+void allocate_in_realtime_context (int num_allocations)
+{
+    rtc::realtime_context rc;
+
+    for (int i = 0; i < num_allocations; ++i)
+        free (malloc (1024));
+}
+
+int main()
+{
+    rtc::set_error_mode (rtc::error_mode::cont);
+
+    assert (rtc::get_violation_stats().total.total() == 0);
+
+    allocate_in_realtime_context (2);
+
+    {
+        const auto thread_counts = rtc::get_violation_stats_for_thread();
+        assert (thread_counts.get (rtc::check_flags::malloc) == 2);
+        assert (thread_counts.get (rtc::check_flags::free) == 2);
+        assert (thread_counts.get (rtc::check_flags::memory) == 4);
+        assert (thread_counts.get (rtc::check_flags::threads) == 0);
+    }
+
+    std::thread t ([] { allocate_in_realtime_context (3); });
+    t.join();
+
+    {
+        const auto stats = rtc::get_violation_stats();
+        assert (stats.total.get (rtc::check_flags::malloc) == 5);
+        assert (stats.total.total() == 10);
+
+        // The other thread has exited so only this one should be listed
+        assert (stats.threads.size() == 1);
+        assert (stats.threads[0].counts.total() == 4);
+    }
+
+    rtc::reset_violation_stats();
+    assert (rtc::get_violation_stats().total.total() == 0);
+    assert (rtc::get_violation_stats_for_thread().total() == 0);
+
+    {
+        rtc::realtime_context rc;
+        rtc::log_function_if_realtime_context (__func__);
+    }
+
+    assert (rtc::get_violation_stats().total.get (rtc::check_flags::custom) == 1);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <rtcheck.h>
+#include "violation_recorder.h"
+
+void spin_in_realtime_context (std::chrono::milliseconds duration)
+{
+    rtc::realtime_context rc;
+
+    for (auto start = std::chrono::steady_clock::now();
+         std::chrono::steady_clock::now() - start < duration;)
+    {}
+}
+
+int main()
+{
+    using namespace std::chrono_literals;
+
+    rtc::set_error_mode (rtc::error_mode::cont);
+    assert (rtc::start_watchdog ({ .threshold = 100ms, .poll_interval = 5ms }));
+    assert (! rtc::start_watchdog());
+
+    // Short scopes shouldn't be reported
+    for (int i = 0; i < 50; ++i)
+        spin_in_realtime_context (1ms);
+
+    assert (rtc::get_violation_stats().total.get (rtc::check_flags::stall) == 0);
+
+    // Time spent in a non_realtime_context doesn't count towards the threshold
+    {
+        rtc::realtime_context rc;
+        rtc::non_realtime_context nrc;
+        std::this_thread::sleep_for (300ms);
+    }
+
+    assert (rtc::get_violation_stats().total.get (rtc::check_flags::stall) == 0);
+
+    // A stalled scope should be reported once
+    spin_in_realtime_context (400ms);
+    rtc::stop_watchdog();
+
+    assert (rtc::get_violation_stats().total.get (rtc::check_flags::stall) == 1);
+
+    // Counted stalls are only added to the stats
+    violation_recorder recorder;
+    rtc::set_violation_handler (violation_recorder::handle_violation, &recorder);
+    rtc::set_error_mode (rtc::error_mode::callback);
+    rtc::set_check_policy (rtc::check_flags::stall, rtc::check_policy::count);
+    assert (rtc::start_watchdog ({ .threshold = 100ms, .poll_interval = 5ms }));
+
+    spin_in_realtime_context (400ms);
+    rtc::stop_watchdog();
+
+    assert (recorder.num_calls == 0);
+    assert (rtc::get_violation_stats().total.get (rtc::check_flags::stall) == 2);
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <rtcheck.h>
+
+/** A violation handler that records the violations it's passed so tests can check them.
+    Pass handle_violation to rtc::set_violation_handler with the recorder as its user data.
+    This doesn't allocate or lock so violations can be recorded on any thread, but the
+    details of the last violation should only be read once the violating threads have finished.
+*/
+struct violation_recorder
+{
+    std::atomic<int> num_calls { 0 };
+    rtc::check_flags last_check {};
+    const char* last_function = "";
+    std::size_t last_size = 0, last_num_frames = 0;
+    const rtc::realtime_token* last_token = nullptr;
+    char last_message[sizeof (rtc::violation_record::message)] {};
+
+    bool last_message_contains (const char* text) const
+    {
+        return std::strstr (last_message, text) != nullptr;
+    }
+
+    static void handle_violation (const rtc::violation_record& record, void* user_data)
+    {
+        auto& recorder = *static_cast<violation_recorder*> (user_data);
+        recorder.last_check = record.check;
+        recorder.last_function = record.function_name;
+        recorder.last_size = record.size;
+        recorder.last_num_frames = record.num_frames;
+        recorder.last_token = record.token;
+        std::memcpy (recorder.last_message, record.message, sizeof (recorder.last_message));
+        ++recorder.num_calls;
+    }
+};
@@ -0,0 +1,458 @@
+/** rtcheck-report
+
+    Merges the violation logs written by rtcheck (see set_violation_log_file and
+    RTCHECK_LOG_FILE), symbolizes their stacks from the ELF files of the logged
+    modules and prints the violations ranked by how often they were hit and how
+    long the violating calls took.
+
+    Usage: rtcheck-report [--top N] [--frames N] <log file or directory>...
+*/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <elf.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "rtcheck_checks.h"
+
+namespace
+{
+    //==============================================================================
+    struct elf_symbol
+    {
+        uint64_t address = 0, size = 0;
+        std::string name;
+    };
+
+    /** The function symbols of an ELF file, sorted by address. */
+    struct symbol_table
+    {
+        std::vector<elf_symbol> symbols;
+
+        const elf_symbol* find (uint64_t address) const
+        {
+            auto it = std::upper_bound (symbols.begin(), symbols.end(), address,
+                                        [] (uint64_t a, const elf_symbol& s) { return a < s.address; });
+
+            if (it == symbols.begin())
+                return nullptr;
+
+            --it;
+
+            // Symbols without a size are matched up to the next symbol
+            if (it->size != 0 && address >= it->address + it->size)
+                return nullptr;
+
+            return &*it;
+        }
+    };
+
+    template<typename Header, typename SectionHeader, typename Symbol, unsigned char (*get_type) (unsigned char)>
+    void read_symbols (const std::vector<char>& file, symbol_table& table)
+    {
+        if (file.size() < sizeof (Header))
+            return;
+
+        Header header;
+        std::memcpy (&header, file.data(), sizeof (header));
+
+        if (header.e_shoff == 0 || header.e_shentsize != sizeof (SectionHeader)
+            || header.e_shoff + header.e_shnum * sizeof (SectionHeader) > file.size())
+            return;
+
+        std::vector<SectionHeader> sections (header.e_shnum);
+        std::memcpy (sections.data(), file.data() + header.e_shoff, sections.size() * sizeof (SectionHeader));
+
+        for (auto& section : sections)
+        {
+            if ((section.sh_type != SHT_SYMTAB && section.sh_type != SHT_DYNSYM)
+                || section.sh_link >= sections.size()
+                || section.sh_offset + section.sh_size > file.size())
+                continue;
+
+            const auto& strings = sections[section.sh_link];
+
+            if (strings.sh_offset + strings.sh_size > file.size())
+                continue;
+
+            for (std::size_t offset = 0; offset + sizeof (Symbol) <= section.sh_size; offset += sizeof (Symbol))
+            {
+                Symbol symbol;
+                std::memcpy (&symbol, file.data() + section.sh_offset + offset, sizeof (symbol));
+
+                if (get_type (symbol.st_info) != STT_FUNC || symbol.st_value == 0
+                    || symbol.st_name >= strings.sh_size)
+                    continue;
+
+                const char* name = file.data() + strings.sh_offset + symbol.st_name;
+                table.symbols.push_back ({ symbol.st_value, symbol.st_size,
+                                           std::string (name, strnlen (name, strings.sh_size - symbol.st_name)) });
+            }
+        }
+
+        // .symtab and .dynsym overlap so keep one symbol per address
+        std::sort (table.symbols.begin(), table.symbols.end(),
+                   [] (auto& a, auto& b) { return a.address < b.address || (a.address == b.address && a.size > b.size); });
+        table.symbols.erase (std::unique (table.symbols.begin(), table.symbols.end(),
+                                          [] (auto& a, auto& b) { return a.address == b.address; }),
+                             table.symbols.end());
+    }
+
+    unsigned char get_elf64_type (unsigned char info) { return ELF64_ST_TYPE (info); }
+    unsigned char get_elf32_type (unsigned char info) { return ELF32_ST_TYPE (info); }
+
+    const symbol_table& get_symbol_table (const std::string& path)
+    {
+        static std::unordered_map<std::string, std::unique_ptr<symbol_table>> tables;
+
+        if (auto it = tables.find (path); it != tables.end())
+            return *it->second;
+
+        auto& table = *tables.emplace (path, std::make_unique<symbol_table>()).first->second;
+
+        std::ifstream stream (path, std::ios::binary);
+        const std::vector<char> file ((std::istreambuf_iterator<char> (stream)), std::istreambuf_iterator<char>());
+
+        if (file.size() < EI_NIDENT || std::memcmp (file.data(), ELFMAG, SELFMAG) != 0)
+            return table;
+
+        if (file[EI_CLASS] == ELFCLASS64)
+            read_symbols<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, get_elf64_type> (file, table);
+        else if (file[EI_CLASS] == ELFCLASS32)
+            read_symbols<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym, get_elf32_type> (file, table);
+
+        return table;
+    }
+
+    std::string demangle (const std::string& name)
+    {
+        int status = 0;
+        std::unique_ptr<char, decltype (&std::free)> demangled (abi::__cxa_demangle (name.c_str(), nullptr, nullptr, &status), &std::free);
+
+        return status == 0 && demangled != nullptr ? demangled.get() : name;
+    }
+
+    std::string get_file_name (const std::string& path)
+    {
+        return std::filesystem::path (path).filename().string();
+    }
+
+    //==============================================================================
+    struct module
+    {
+        uint64_t load_bias = 0, begin = 0, end = 0;
+        std::string path;
+    };
+
+    struct frame
+    {
+        std::string location;
+        bool is_rtcheck = false;
+    };
+
+    /** Returns the function containing a return address, or the module and offset if it can't be found. */
+    frame symbolize (const std::vector<module>& modules, uint64_t pc)
+    {
+        auto m = std::find_if (modules.begin(), modules.end(),
+                               [pc] (auto& mod) { return pc >= mod.begin && pc < mod.end; });
+
+        if (m == modules.end())
+        {
+            char location[32];
+            std::snprintf (location, sizeof (location), "0x%llx", static_cast<unsigned long long> (pc));
+            return { location, false };
+        }
+
+        const auto file_name = get_file_name (m->path);
+        const bool is_rtcheck = file_name.starts_with ("librtcheck");
+
+        // Frames are return addresses so look up the call instruction before them
+        const auto address = pc - 1 - m->load_bias;
+
+        if (auto symbol = get_symbol_table (m->path).find (address))
+            return { demangle (symbol->name), is_rtcheck };
+
+        char offset[32];
+        std::snprintf (offset, sizeof (offset), "+0x%llx", static_cast<unsigned long long> (address));
+        return { file_name + offset, is_rtcheck };
+    }
+
+    //==============================================================================
+    /** Returns the name of a check index written to the log, or the index if it's from a newer version. */
+    std::string get_check_name (std::size_t check)
+    {
+        constexpr const char* names[] =
+        {
+           #define RTCHECK_CHECK_NAME(name, group, platform) #name,
+            RTCHECK_CHECKS (RTCHECK_CHECK_NAME)
+           #undef RTCHECK_CHECK_NAME
+        };
+
+        if (check < std::size (names))
+            return names[check];
+
+        return std::to_string (check);
+    }
+
+    //==============================================================================
+    struct violation_group
+    {
+        std::string check;
+        std::string function;
+        std::vector<std::string> stack;
+        uint64_t hits = 0, num_costs = 0;
+        int64_t total_cost_ns = 0;
+        std::size_t num_processes = 0;
+        uint64_t last_process = 0;
+        std::map<std::string, uint64_t> scopes;
+    };
+
+    struct report
+    {
+        std::size_t max_frames = 4;
+        uint64_t num_processes = 0, num_violations = 0;
+        std::map<std::string, violation_group> groups;
+    };
+
+    /** The state of the process currently being read from a log. */
+    struct process
+    {
+        std::vector<module> modules;
+        std::unordered_map<uint64_t, violation_group*> violations;
+    };
+
+    void add_violation (report& r, process& p, std::istringstream& line)
+    {
+        uint64_t id = 0, thread_id = 0;
+        std::size_t check = 0, size = 0, alignment = 0, num_frames = 0;
+        line >> id >> check >> thread_id >> size >> alignment >> num_frames;
+
+        if (! line)
+            return;
+
+        std::vector<frame> frames;
+
+        for (std::size_t i = 0; i < num_frames; ++i)
+        {
+            uint64_t pc = 0;
+            line >> std::hex >> pc >> std::dec;
+            frames.push_back (symbolize (p.modules, pc));
+        }
+
+        std::string function;
+
+        if (! std::getline (line >> std::ws, function))
+            return;
+
+        // rtcheck's own frames are the same for every violation so are skipped
+        auto first = std::find_if (frames.begin(), frames.end(), [] (auto& f) { return ! f.is_rtcheck; });
+
+        std::vector<std::string> stack;
+        // Different checks can be reported by the same function, e.g. a wait with a zero timeout
+        std::string key = function + '\n' + std::to_string (check);
+
+        for (auto f = first; f != frames.end() && stack.size() < r.max_frames; ++f)
+        {
+            stack.push_back (f->location);
+            (key += '\n') += f->location;
+        }
+
+        auto& group = r.groups[key];
+
+        if (group.hits == 0)
+        {
+            group.check = get_check_name (check);
+            group.function = function;
+            group.stack = std::move (stack);
+        }
+
+        ++group.hits;
+        ++r.num_violations;
+
+        if (group.last_process != r.num_processes)
+        {
+            group.last_process = r.num_processes;
+            ++group.num_processes;
+        }
+
+        p.violations[id] = &group;
+    }
+
+    void read_log (report& r, std::istream& stream)
+    {
+        process p;
+
+        for (std::string text; std::getline (stream, text);)
+        {
+            std::istringstream line (text);
+            std::string type;
+            line >> type;
+
+            if (type == "rtcheck-log")
+            {
+                // Logs are appended to so each header starts a new process
+                p = {};
+                ++r.num_processes;
+            }
+            else if (type == "module")
+            {
+                module m;
+                line >> std::hex >> m.load_bias >> m.begin >> m.end >> std::dec;
+
+                if (line && std::getline (line >> std::ws, m.path))
+                    p.modules.push_back (std::move (m));
+            }
+            else if (type == "violation")
+            {
+                add_violation (r, p, line);
+            }
+            else if (type == "cost")
+            {
+                uint64_t id = 0;
+                int64_t ns = 0;
+
+                if ((line >> id >> ns) && p.violations.contains (id))
+                {
+                    auto& group = *p.violations[id];
+                    group.total_cost_ns += ns;
+                    ++group.num_costs;
+                }
+            }
+            else if (type == "scope")
+            {
+                uint64_t id = 0;
+                std::string label;
+
+                if ((line >> id) && std::getline (line >> std::ws, label) && p.violations.contains (id))
+                    ++p.violations[id]->scopes[label];
+            }
+        }
+    }
+
+    void read_path (report& r, const std::filesystem::path& path)
+    {
+        if (std::filesystem::is_directory (path))
+        {
+            std::vector<std::filesystem::path> files;
+
+            for (auto& entry : std::filesystem::recursive_directory_iterator (path))
+                if (entry.is_regular_file())
+                    files.push_back (entry.path());
+
+            std::sort (files.begin(), files.end());
+
+            for (auto& file : files)
+                read_path (r, file);
+
+            return;
+        }
+
+        std::ifstream stream (path);
+
+        if (! stream)
+        {
+            std::cerr << "rtcheck-report: unable to open " << path.string() << '\n';
+            return;
+        }
+
+        // Skip anything that isn't an rtcheck log when reading directories
+        if (std::string header; ! (stream >> header) || header != "rtcheck-log")
+            return;
+
+        stream.seekg (0);
+        read_log (r, stream);
+    }
+
+    //==============================================================================
+    void print_report (const report& r, std::size_t top)
+    {
+        std::vector<const violation_group*> ranked;
+
+        for (auto& [key, group] : r.groups)
+            ranked.push_back (&group);
+
+        std::sort (ranked.begin(), ranked.end(),
+                   [] (auto a, auto b) { return a->hits != b->hits ? a->hits > b->hits
+                                                                   : a->total_cost_ns > b->total_cost_ns; });
+
+        std::printf ("%llu violations in %llu processes, %zu unique\n\n",
+                     static_cast<unsigned long long> (r.num_violations),
+                     static_cast<unsigned long long> (r.num_processes), ranked.size());
+        std::printf ("%10s %10s %12s %10s  %-20s %-24s %s\n", "hits", "processes", "total ms", "mean us", "check", "function", "location");
+
+        for (std::size_t i = 0; i < ranked.size() && i < top; ++i)
+        {
+            auto& group = *ranked[i];
+            const auto total_ms = static_cast<double> (group.total_cost_ns) / 1.0e6;
+            const auto mean_us = group.num_costs > 0 ? static_cast<double> (group.total_cost_ns) / 1.0e3 / static_cast<double> (group.num_costs) : 0.0;
+
+            std::string location;
+
+            for (auto& f : group.stack)
+                (location += location.empty() ? "" : " <- ") += f;
+
+            std::printf ("%10llu %10zu %12.3f %10.3f  %-20s %-24s %s\n",
+                         static_cast<unsigned long long> (group.hits), group.num_processes,
+                         total_ms, mean_us, group.check.c_str(), group.function.c_str(), location.c_str());
+
+            for (auto& [label, hits] : group.scopes)
+                std::printf ("%10llu %10s %12s %10s    in realtime_context \"%s\"\n",
+                             static_cast<unsigned long long> (hits), "", "", "", label.c_str());
+        }
+    }
+
+    int print_usage()
+    {
+        std::cerr << "Usage: rtcheck-report [--top N] [--frames N] <log file or directory>...\n";
+        return 2;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    report r;
+    std::size_t top = SIZE_MAX;
+    std::vector<std::filesystem::path> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg (argv[i]);
+
+        if ((arg == "--top" || arg == "--frames") && i + 1 < argc)
+        {
+            const auto value = std::strtoull (argv[++i], nullptr, 10);
+            (arg == "--top" ? top : r.max_frames) = static_cast<std::size_t> (value);
+        }
+        else if (arg.starts_with ("-"))
+        {
+            return print_usage();
+        }
+        else
+        {
+            paths.emplace_back (arg);
+        }
+    }
+
+    if (paths.empty())
+        return print_usage();
+
+    for (auto& path : paths)
+        read_path (r, path);
+
+    print_report (r, top);
+
+    return 0;
+}